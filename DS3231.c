@@ -1,33 +1,49 @@
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Stats.h"
+#include "DS3231_Bcd.h"
+#include "DS3231_Trace.h"
 #include "Gpio.h"
 #include "Timer.h"
-#include "WDT.h"
-#include "DS3231.h"
-#include "TWI.h"
-#include "USART.h"
-#include <stdio.h>
+#include <util/atomic.h>
+#include <string.h>
+#include <avr/pgmspace.h>
 
-#define SECONDS_ADDRESS 0x00
-#define MINUTES_ADDRESS 0x01
-#define HOURS_ADDRESS 0x02
-#define DAY_ADDRESS 0x03
-#define DATE_ADDRESS 0x04
-#define MONTH_ADDRESS 0x05
-#define YEAR_ADDRESS 0x06
+// write-through shadow copies of the control register and of the writable bit (EN32kHz) of the status register
+#define CTRL_CONV 0b00100000 // CONV bit of the control register, never kept in the shadow (cleared by the DS3231 itself)
+#define STATUS_EN32KHZ 0b00001000 // EN32kHz bit of the status register
+#define STATUS_KEEP_FLAGS 0b10000011 // OSF, A2F and A1F: writing a 1 leaves these flags unchanged
+#define SHADOW_CTRL_VALID 0x01
+#define SHADOW_STATUS_VALID 0x02
+#define SHADOW_ALARM1_VALID 0x04
+#define SHADOW_ALARM2_VALID 0x08
+#define PRECISE_WRITE_CLOCKS 28 // SCL periods from the start condition to the ack of the seconds byte (start, address, register and seconds byte)
+#define PRECISE_REST_CLOCKS 55 // SCL periods from the ack of the seconds byte to the end of the write (6 bytes and the stop condition)
+#define PRECISE_EDGE_MS 500 // the 1 Hz square wave changes its level every 500 ms, counted from the reset of the countdown chain
 
-#define ALARM1_SEC_ADDRESS 0x07
-#define ALARM1_MIN_ADDRESS 0x08
-#define ALARM1_HOUR_ADDRESS 0x09
-#define ALARM1_DYDT_ADDRESS 0x0A
+// calendar of the date conversions (years 0 to 199 = 2000 to 2199)
+#define DS3231_IS_LEAP(year) (((year) & 0x03) == 0 && (year) != 100) // 2100 is no leap year
+static const uint16_t days_before_month[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334}; // non leap year
 
-#define ALARM2_MIN_ADDRESS 0x0B
-#define ALARM2_HOUR_ADDRESS 0x0C
-#define ALARM2_DYDT_ADDRESS 0x0D
+static uint8_t shadow_ctrl; // last value written to / read from the control register
+static uint8_t shadow_en32k; // EN32kHz bit of the status register
+static uint8_t shadow_alarm1[4]; // last value written to / read from the alarm 1 registers (0x07 to 0x0A)
+static uint8_t shadow_alarm2[3]; // last value written to / read from the alarm 2 registers (0x0B to 0x0D)
+static uint8_t shadow_valid = 0; // SHADOW_CTRL_VALID, SHADOW_STATUS_VALID, SHADOW_ALARM1_VALID and/or SHADOW_ALARM2_VALID
 
-#define CTRL_ADDRESS 0x0E
-#define STATUS_ADDRESS 0x0F
+// state of the software clock (see DS3231_SoftClock_Start)
+static volatile struct DS3231_DateTime soft_time; // RAM copy of the date and time, advanced by DS3231_SoftClock_Tick
+static volatile uint8_t soft_active = 0; // 1 if the date and time are served from soft_time
+static volatile uint8_t soft_edges = 0; // free running count of 1 Hz edges, used to detect an edge during a bus read
+static volatile uint16_t soft_ticks_since_sync = 0; // number of edges since the last resync with the DS3231
+static uint16_t soft_resync_period = 0; // number of edges after which DS3231_SoftClock_Service resyncs
+static uint16_t soft_drift_count = 0; // number of resyncs on which the RAM copy differed from the DS3231
+static int32_t soft_last_drift = 0; // difference (DS3231 - RAM copy, in seconds) found on the last resync with drift
 
-
-//#define DEBUG_DS3231 1 // uncomment this define for activating the debug output via the USART0
+static uint8_t DS3231_SoftClock_Sync(void);
+static void DS3231_AdvanceSecond(volatile struct DS3231_DateTime* t);
+static void DS3231_DecodeDateTime(const uint8_t* raw, struct DS3231_DateTime* pDateTime);
+static uint8_t DS3231_WriteStatus(uint8_t clear);
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_PutInKnownI2CState
@@ -35,69 +51,129 @@
 //              This may be necessary in case the microcontroller resets during a communication
 //              with the DS3231. In that case the DS3231 I2C driver is locked into the state from
 //              during the communication and as a result will not respond to a new start condition.
-//              The routing of this function resets this lockup.
+//              SCL is pulsed at the bus speed until the DS3231 releases SDA (at most 9 pulses)
+//              and a stop condition is sent, see DS3231_Bus_Recover. Can be called before
+//              DS3231_Init.
 // Arguments: none
 //
 // Returns:
 //  - 0: if DS3231 is succesfully put in its default I2C state
-//  - 1: if a timeout error occured
+//  - 1: if the bus is still stuck (SCL or SDA held low)
 uint8_t DS3231_PutInKnownI2CState(void)
 {
-  GPIO_PinMode(GPIOC, GPIO_PIN_4, GPIO_INPUT, GPIO_PULLUP);
-  if(GPIO_ReadPin(GPIOC, GPIO_PIN_4))
-    return 0;
-  else
-  {
-    GPIO_PinMode(GPIOC, GPIO_PIN_5, GPIO_OUTPUT, GPIO_NOPULLUP);
-    WDT_Init();
-    while (GPIO_ReadPin(GPIOC, GPIO_PIN_4) == 0)
-    {
-      if(WDT_Return_Flag())
-      {
-        WDT_Reset_Flag();
-        return 1;
-      }
-      GPIO_TogglePin(GPIOC, GPIO_PIN_5);
-      Timer0_Delay_us(1000);
-    }
-    WDT_Disable();
-    return 0;
-  }
+  DS3231_STATS_FUNC(DS3231_FN_PUT_IN_KNOWN_STATE);
+  return DS3231_Bus_Recover();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_Init
-// Description: This function writes the control register of the DS3231
+// Description: This function initializes the TWI bus with the CPU frequency and bus speed
+//              of the DS3231_Init_Struct and writes the control register of the DS3231. The
+//              write is skipped when the shadow copy shows that the register already holds
+//              the value (e.g. after DS3231_Restore). The SCL frequency that is actually
+//              achieved can be read with DS3231_GetBusFrequency.
 // Arguments:
 //  - struct DS3231_Init_Struct* pStruct: pointer to a DS3231_Init_Struct that contains
-//           the parameters for configuring the control register
+//           the parameters for configuring the bus and the control register
 //
 // Returns:
 //  - 0: if control register was succesfully written
 //  - 1: if a timeout error occured in the TWI driver
+//  - 2: if the bus speed can not be achieved with the CPU frequency (nothing is written)
 //  - else: other codes represent specific TWI status errors, see TWI chapter in
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_Init(struct DS3231_Init_Struct* pStruct)
 {
-  I2C_Init(SYSCLOCKFREQ, I2C_NORMAL_SPEED_MODE, I2C_PULLUP_EN);
+  DS3231_STATS_FUNC(DS3231_FN_INIT);
+  uint32_t cpu_freq = (pStruct->CpuFrequency != 0) ? pStruct->CpuFrequency : SYSCLOCKFREQ;
+  uint32_t bus_speed = (pStruct->BusSpeed != 0) ? pStruct->BusSpeed : DS3231_BUS_100KHZ;
+  if(DS3231_Bus_Init(cpu_freq, bus_speed) != 0)
+    return 2;
+
   uint8_t ctrl_dat = pStruct->EnableOscillator | pStruct->SquareWaveOrInterrupt | pStruct->BatteryBackedSquareWave | pStruct->SquareWaveFreq | pStruct->Alarm1InterruptEnable | pStruct->Alarm2InterruptEnable;
-  uint8_t ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, CTRL_ADDRESS, ctrl_dat);
+  if((shadow_valid & SHADOW_CTRL_VALID) && shadow_ctrl == ctrl_dat)
+    return 0; // the DS3231 is already configured
+
+  uint8_t ret = DS3231_Bus_Write(CTRL_ADDRESS, &ctrl_dat, 1);
   if(ret != 0)
+  {
+    shadow_valid &= ~SHADOW_CTRL_VALID; // the register may or may not have been written
     return ret;
+  }
+  shadow_ctrl = ctrl_dat & ~CTRL_CONV;
+  shadow_valid |= SHADOW_CTRL_VALID;
 
-  uint8_t buf;
-  I2C_Read_From_Slave(DS3231_I2C_ADDRESS, CTRL_ADDRESS, &buf);
-  char buffer[100];
-  snprintf(&buffer[0], 100, "value in CTRL-reg: %X\n", buf);
-  USART_PrintString(buffer);
-
+  DS3231_TRACE_EVENT(DS3231_EV_INIT, CTRL_ADDRESS, ctrl_dat);
   return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Restore
+// Description: This function reads the complete register file (0x00 to 0x12) in one burst
+//              and loads the shadow copies of the control, status and alarm registers from
+//              it. Called after a reset of the ATmega328 (before DS3231_Init), the following
+//              DS3231_Init, DS3231_SetAlarm1 and DS3231_SetAlarm2 only write registers whose
+//              content differs, so a warm start with an already configured DS3231 needs this
+//              single transaction. When the bus is not initialized yet it is initialized with
+//              SYSCLOCKFREQ and 100 kHz, DS3231_Init sets the requested speed later.
+//              The OSF flag tells whether the time can be trusted: it is set when the
+//              oscillator stopped (e.g. first power-up or empty battery). It stays set until
+//              the time has been set and DS3231_ClearOscillatorStopFlag is called.
+// Arguments:
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       date and time (also filled when OSF is set), may be 0
+//
+// Returns:
+//  - 0: if the registers were read and the time is valid
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: if the registers were read but OSF is set, the time is not valid
+//  - 3: if the bus could not be initialized (SYSCLOCKFREQ too low for 100 kHz)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Restore(struct DS3231_DateTime* pDateTime)
+{
+  DS3231_STATS_FUNC(DS3231_FN_RESTORE);
+  uint8_t buf[REGISTER_COUNT];
+  uint8_t ret;
+
+  if(DS3231_Bus_GetFrequency() == 0 && DS3231_Bus_Init(SYSCLOCKFREQ, DS3231_BUS_100KHZ) != 0)
+    return 3;
+  ret = DS3231_Bus_Read(SECONDS_ADDRESS, buf, REGISTER_COUNT);
+  if(ret != 0)
+    return ret;
+
+  memcpy(shadow_alarm1, &buf[ALARM1_SEC_ADDRESS], 4);
+  memcpy(shadow_alarm2, &buf[ALARM2_MIN_ADDRESS], 3);
+  shadow_ctrl = buf[CTRL_ADDRESS] & ~CTRL_CONV;
+  shadow_en32k = buf[STATUS_ADDRESS] & STATUS_EN32KHZ;
+  shadow_valid = SHADOW_CTRL_VALID | SHADOW_STATUS_VALID | SHADOW_ALARM1_VALID | SHADOW_ALARM2_VALID;
+  if(pDateTime != 0)
+    DS3231_DecodeDateTime(buf, pDateTime);
+  return (buf[STATUS_ADDRESS] & DS3231_FLAG_OSF) ? 2 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ClearOscillatorStopFlag
+// Description: This function clears the OSF flag of the status register (the alarm flags and
+//              EN32kHz are left unchanged), call it after the time has been set.
+// Arguments: none
+//
+// Returns:
+//  - 0: if the flag was succesfully cleared
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ClearOscillatorStopFlag(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_CLEAR_OSF);
+  return DS3231_WriteStatus(DS3231_FLAG_OSF);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_SetTime
 // Description: This function sets the time in the timekeeping registers of the
-//              DS3231.
+//              DS3231. All arguments are validated first, the registers are then written
+//              in one burst transaction.
 // Arguments:
 //  - uint8_t seconds: seconds that will be stored in seconds registers
 //  - uint8_t minutes: minutes that will be stored in minutes registers
@@ -110,33 +186,29 @@ uint8_t DS3231_Init(struct DS3231_Init_Struct* pStruct)
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_SetTime(uint8_t seconds, uint8_t minutes, uint8_t hours)
 {
-  uint8_t ret;
+  DS3231_STATS_FUNC(DS3231_FN_SET_TIME);
+  uint8_t buf[3];
 
   if(seconds > 59)
     return 2;
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, SECONDS_ADDRESS, ((seconds%10) | ((seconds/10)<<4)));
-  if(ret != 0)
-    return ret;
-
   if(minutes > 59)
     return 3;
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, MINUTES_ADDRESS, ((minutes%10) | ((minutes/10)<<4)));
-  if(ret != 0)
-    return ret;
-
   if(hours > 23)
     return 4;
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, HOURS_ADDRESS, ((hours%10) | ((hours/10)<<4)));
-  if(ret != 0)
-    return ret;
 
-  return 0;
+  buf[0] = DS3231_EncodeBCD(seconds);
+  buf[1] = DS3231_EncodeBCD(minutes);
+  buf[2] = DS3231_EncodeBCD(hours);
+  uint8_t ret = DS3231_Bus_Write(SECONDS_ADDRESS, buf, 3);
+  if(ret == 0 && soft_active)
+    ret = DS3231_SoftClock_Sync(); // the RAM copy of the software clock is no longer valid
+  return ret;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_ReadTime
 // Description: This function reads the time from the timekeeping registers in the
-//              DS3231.
+//              DS3231. The registers are read in one burst with DS3231_ReadDateTime.
 // Arguments:
 //  - uint8_t* seconds: pointer to a uint8_t variable to store the read seconds
 //  - uint8_t* minutes: pointer to a uint8_t variable to store the read minutes
@@ -149,62 +221,31 @@ uint8_t DS3231_SetTime(uint8_t seconds, uint8_t minutes, uint8_t hours)
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_ReadTime(uint8_t* seconds, uint8_t* minutes, uint8_t* hours)
 {
-  uint8_t ret;
-  uint8_t buf;
+  DS3231_STATS_FUNC(DS3231_FN_READ_TIME);
+  struct DS3231_DateTime dt;
+  uint8_t ret = DS3231_ReadDateTime(&dt);
+  if(ret != 0)
+    return ret;
 
   if(seconds != 0)
-  {
-    ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, SECONDS_ADDRESS, &buf);
-    if(ret != 0)
-      return ret;
-    else
-    {
-      *seconds = (buf&0x0F) + (((buf&0x70)>>4)*10);
-    }
-  #ifdef DEBUG_DS3231
-    USART_PrintString("seconds succesfully read\n");
-  #endif
-  }
-
+    *seconds = dt.seconds;
   if(minutes != 0)
-  {
-    ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, MINUTES_ADDRESS, &buf);
-    if(ret != 0)
-      return ret;
-    else
-    {
-      *minutes = (buf&0x0F) + (((buf&0x70)>>4)*10);
-    }
-    #ifdef DEBUG_DS3231
-      USART_PrintString("minutes succesfully read\n");
-    #endif
-  }
-
+    *minutes = dt.minutes;
   if(hours != 0)
-  {
-    ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, HOURS_ADDRESS, &buf);
-    if(ret != 0)
-      return ret;
-    else
-    {
-      *hours = (buf&0x0F) + (((buf&0x30)>>4)*10);
-    }
-  #ifdef DEBUG_DS3231
-    USART_PrintString("hours succesfully read\n");
-  #endif
-  }
+    *hours = dt.hours;
   return 0;
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_SetDate
 // Description: This function sets the date in the datekeeping registers in the
-//              DS3231.
+//              DS3231. All arguments are validated first, the registers are then written
+//              in one burst transaction.
 // Arguments:
 //  - uint8_t day_of_month: day of the month will be stored in register 0x04
 //  - uint8_t month: month will be stored in register 0x05
-//  - uint8_t year: year will be stored in register 0x06
+//  - uint8_t year: year (0 to 199 = 2000 to 2199) will be stored in register 0x06, the
+//                  hundreds go into the century bit of register 0x05
 //
 // Returns:
 //  - 0: if date was succesfully send
@@ -213,33 +254,200 @@ uint8_t DS3231_ReadTime(uint8_t* seconds, uint8_t* minutes, uint8_t* hours)
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_SetDate(uint8_t day_of_month, uint8_t month, uint8_t year)
 {
-  uint8_t ret;
+  DS3231_STATS_FUNC(DS3231_FN_SET_DATE);
+  uint8_t buf[3];
 
   if(day_of_month > 31)
     return 2;
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, DATE_ADDRESS, ((day_of_month%10) | ((day_of_month/10)<<4)));
+  if(month > 12)
+    return 3;
+  if(year > 199)
+    return 4;
+
+  buf[0] = DS3231_EncodeBCD(day_of_month);
+  buf[1] = DS3231_EncodeBCD(month);
+  if(year >= 100)
+  {
+    year -= 100;
+    buf[1] |= DS3231_BCD_CENTURY;
+  }
+  buf[2] = DS3231_EncodeBCD(year);
+  uint8_t ret = DS3231_Bus_Write(DATE_ADDRESS, buf, 3);
+  if(ret == 0 && soft_active)
+    ret = DS3231_SoftClock_Sync(); // the RAM copy of the software clock is no longer valid
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_CheckDateTime
+// Description: This function checks the fields of a date and time before it is written
+//              (also used by DS3231.hpp).
+// Arguments:
+//  - const struct DS3231_DateTime* pDateTime: the date and time
+//
+// Returns: 0 if all fields are valid, else the code of DS3231_SetDateTime for the first
+//          invalid field (2 to 8)
+uint8_t DS3231_CheckDateTime(const struct DS3231_DateTime* pDateTime)
+{
+  if(pDateTime->seconds > 59)
+    return 2;
+  if(pDateTime->minutes > 59)
+    return 3;
+  if(pDateTime->hours > 23)
+    return 4;
+  if(pDateTime->day < 1 || pDateTime->day > 7)
+    return 5;
+  if(pDateTime->day_of_month < 1 || pDateTime->day_of_month > 31)
+    return 6;
+  if(pDateTime->month < 1 || pDateTime->month > 12)
+    return 7;
+  if(pDateTime->year > 199)
+    return 8;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetDateTime
+// Description: This function sets the complete date and time (registers 0x00 to 0x06) of
+//              the DS3231 in a single burst transaction. All fields are validated before
+//              anything is written, so an invalid field leaves the clock untouched, and the
+//              time can not tear in between setting the time and the date.
+// Arguments:
+//  - const struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct that
+//                                             contains the date and time to set
+//
+// Returns:
+//  - 0: if date and time were succesfully set
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: invalid seconds (valid: 0 to 59)
+//  - 3: invalid minutes (valid: 0 to 59)
+//  - 4: invalid hours (valid: 0 to 23)
+//  - 5: invalid day of the week (valid: 1 to 7)
+//  - 6: invalid day of the month (valid: 1 to 31)
+//  - 7: invalid month (valid: 1 to 12)
+//  - 8: invalid year (valid: 0 to 199)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SetDateTime(const struct DS3231_DateTime* pDateTime)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_DATE_TIME);
+  uint8_t buf[7];
+
+  uint8_t ret = DS3231_CheckDateTime(pDateTime);
   if(ret != 0)
     return ret;
 
-  if(month > 12)
-    return 3;
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, MONTH_ADDRESS, ((month%10) | ((month/10)<<4)));
+  DS3231_EncodeBCDBlock((const uint8_t*)pDateTime, buf); // the fields of DS3231_DateTime are in register order
+  ret = DS3231_Bus_Write(SECONDS_ADDRESS, buf, 7);
+  if(ret == 0 && soft_active)
+    ret = DS3231_SoftClock_Sync(); // the RAM copy of the software clock is no longer valid
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetDateTimePrecise
+// Description: This function sets the date and time so that the DS3231 starts the next
+//              second exactly on the second boundary of the caller's time. The caller passes
+//              the current time: pDateTime plus subsec_ms milliseconds (e.g. a timestamp of a
+//              host corrected by the known transfer latency). The function waits until the
+//              next boundary and writes pDateTime + 1 s in one burst. The DS3231 resets its
+//              countdown chain when the seconds register is written, on the ack of the
+//              seconds byte, so the write is started earlier by the time the start
+//              condition and the first 3 bytes take at the SCL frequency of DS3231_Init
+//              (280 us at 100 kHz). The wait uses Timer0_Delay_us in 1 ms steps and blocks
+//              for up to one second.
+//              With edge_error_ms the write is verified on the 1 Hz square wave (INT/SQW
+//              connected to DS3231_SQW_PORT/DS3231_SQW_PIN, SquareWaveOrInterrupt =
+//              SQUAREWAVE_FUNC and SquareWaveFreq = SWFREQ_1HZ): the first edge after the
+//              reset must come 500 ms after the write. The pin is polled every millisecond,
+//              this blocks for another 500 ms.
+// Arguments:
+//  - const struct DS3231_DateTime* pDateTime: the current date and time (whole seconds)
+//  - uint16_t subsec_ms: milliseconds elapsed since the second of pDateTime began (0 to 999)
+//  - int16_t* edge_error_ms: pointer to a int16_t variable to store the measured time of the
+//                            first edge minus 500 ms (1 ms resolution), 0 to skip the check
+//
+// Returns:
+//  - 0: if date and time were set (and verified)
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2 to 8: invalid field, see DS3231_SetDateTime (nothing is written)
+//  - 9: invalid subsec_ms (nothing is written)
+//  - 10: the check was requested but the INT/SQW pin does not output 1 Hz (nothing is written)
+//  - 11: the check failed, no edge or the edge is more than DS3231_PRECISE_TOLERANCE_MS off
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SetDateTimePrecise(const struct DS3231_DateTime* pDateTime, uint16_t subsec_ms, int16_t* edge_error_ms)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_DATE_TIME_PRECISE);
+  struct DS3231_DateTime dt;
+  uint8_t buf[7], ret, level;
+  uint32_t scl, wait_us, bus_us;
+  int16_t ms;
+
+  ret = DS3231_CheckDateTime(pDateTime);
   if(ret != 0)
     return ret;
+  if(subsec_ms > 999)
+    return 9;
+  if(edge_error_ms != 0)
+  {
+    if(!(shadow_valid & SHADOW_CTRL_VALID))
+    {
+      ret = DS3231_Bus_Read(CTRL_ADDRESS, &buf[0], 1);
+      if(ret != 0)
+        return ret;
+      shadow_ctrl = buf[0] & ~CTRL_CONV;
+      shadow_valid |= SHADOW_CTRL_VALID;
+    }
+    if(shadow_ctrl & (INTERRUPT_FUNC | SWFREQ_8192HZ))
+      return 10;
+  }
 
-  if(year > 99)
-    return 4;
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, YEAR_ADDRESS, ((year%10) | ((year/10)<<4)));
+  dt = *pDateTime;
+  DS3231_AdvanceSecond(&dt);
+  DS3231_EncodeBCDBlock((const uint8_t*)&dt, buf);
+
+  scl = DS3231_Bus_GetFrequency();
+  bus_us = (scl != 0) ? (PRECISE_WRITE_CLOCKS*1000000UL + scl/2) / scl : 0;
+  wait_us = (uint32_t)(1000 - subsec_ms) * 1000;
+  wait_us = (wait_us > bus_us) ? wait_us - bus_us : 0;
+  for(; wait_us > 1000; wait_us -= 1000)
+    Timer0_Delay_us(1000);
+  Timer0_Delay_us((uint16_t)wait_us);
+
+  ret = DS3231_Bus_Write(SECONDS_ADDRESS, buf, 7);
   if(ret != 0)
     return ret;
 
-  return 0;
+  if(edge_error_ms != 0)
+  {
+    level = GPIO_ReadPin(DS3231_SQW_PORT, DS3231_SQW_PIN);
+    for(ms = 1; ms <= PRECISE_EDGE_MS + DS3231_PRECISE_TOLERANCE_MS; ms++)
+    {
+      Timer0_Delay_us(1000);
+      if(GPIO_ReadPin(DS3231_SQW_PORT, DS3231_SQW_PIN) != level)
+        break;
+    }
+    if(scl != 0)
+      ms += (PRECISE_REST_CLOCKS*1000UL + scl/2) / scl; // the polling started at the end of the write
+    *edge_error_ms = ms - PRECISE_EDGE_MS;
+    if(*edge_error_ms > DS3231_PRECISE_TOLERANCE_MS || *edge_error_ms < -DS3231_PRECISE_TOLERANCE_MS)
+      ret = 11;
+  }
+
+  if(soft_active)
+  {
+    uint8_t sync = DS3231_SoftClock_Sync(); // the RAM copy of the software clock is no longer valid
+    if(ret == 0)
+      ret = sync;
+  }
+  return ret;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_ReadDate
 // Description: This function reads the date from the datekeeping registers in the
-//              DS3231.
+//              DS3231. The registers are read in one burst with DS3231_ReadDateTime.
 // Arguments:
 //  - uint8_t* day_of_month: pointer to a uint8_t variable to store the read day of month
 //  - uint8_t* month: pointer to a uint8_t variable to store the read month
@@ -252,56 +460,187 @@ uint8_t DS3231_SetDate(uint8_t day_of_month, uint8_t month, uint8_t year)
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_ReadDate(uint8_t* day_of_month, uint8_t* month, uint8_t* year)
 {
-  uint8_t ret;
-  uint8_t buf;
+  DS3231_STATS_FUNC(DS3231_FN_READ_DATE);
+  struct DS3231_DateTime dt;
+  uint8_t ret = DS3231_ReadDateTime(&dt);
+  if(ret != 0)
+    return ret;
 
   if(day_of_month != 0)
+    *day_of_month = dt.day_of_month;
+  if(month != 0)
+    *month = dt.month;
+  if(year != 0)
+    *year = dt.year;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DecodeDateTime
+// Description: This function decodes the register values of the timekeeping block (0x00
+//              to 0x06). Every field is decoded only from its own register value, so raw and
+//              pDateTime may point to the same memory (decoding in place).
+// Arguments:
+//  - const uint8_t* raw: the 7 register values
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       decoded date and time
+//
+// Returns: nothing
+static void DS3231_DecodeDateTime(const uint8_t* raw, struct DS3231_DateTime* pDateTime)
+{
+  DS3231_DecodeBCDBlock(raw, (uint8_t*)pDateTime); // the fields of DS3231_DateTime are in register order
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DecodeDateTimeInPlace
+// Description: Post-processing hook of DS3231_ReadDateTimeAsync, decodes the raw register
+//              values that were read into the DS3231_DateTime struct itself.
+// Arguments:
+//  - uint8_t* buf: the DS3231_DateTime struct holding the raw register values
+//
+// Returns: nothing
+static void DS3231_DecodeDateTimeInPlace(uint8_t* buf)
+{
+  DS3231_DecodeDateTime(buf, (struct DS3231_DateTime*)buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_FetchDateTime
+// Description: This function reads the complete timekeeping block (registers 0x00 to 0x06)
+//              of the DS3231 in a single burst transaction and decodes it. Because all
+//              registers are read in one transaction the result is a consistent snapshot,
+//              the seconds can not roll over in between reading the other registers.
+// Arguments:
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       read date and time
+//
+// Returns:
+//  - 0: if date and time were succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+static uint8_t DS3231_FetchDateTime(struct DS3231_DateTime* pDateTime)
+{
+  uint8_t buf[7];
+  uint8_t ret = DS3231_Bus_Read(SECONDS_ADDRESS, buf, 7);
+  if(ret != 0)
+    return ret;
+
+  DS3231_DecodeDateTime(buf, pDateTime);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadDateTime
+// Description: This function reads the complete date and time. Normally the timekeeping
+//              block is read from the DS3231 with DS3231_FetchDateTime (one burst
+//              transaction). When the software clock runs (see DS3231_SoftClock_Start) the
+//              date and time are copied from RAM without any bus traffic.
+// Arguments:
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       read date and time
+//
+// Returns:
+//  - 0: if date and time were succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ReadDateTime(struct DS3231_DateTime* pDateTime)
+{
+  DS3231_STATS_FUNC(DS3231_FN_READ_DATE_TIME);
+  if(soft_active)
   {
-    ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, DATE_ADDRESS, &buf);
-    if(ret != 0)
-      return ret;
-    else
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-      *day_of_month = (buf&0x0F) + (((buf&0x30)>>4)*10);
+      *pDateTime = *(struct DS3231_DateTime*)&soft_time;
     }
-    #ifdef DEBUG_DS3231
-    USART_PrintString("day of month succesfully read\n");
-    #endif
+    return 0;
   }
+  return DS3231_FetchDateTime(pDateTime);
+}
 
-  if(month != 0)
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadDateTimeAsync
+// Description: This function starts reading the complete date and time without waiting
+//              for the bus. The burst read is queued on the interrupt driven transaction
+//              engine, the CPU can continue while the transfer runs. When the software clock
+//              runs the date and time are copied from RAM and done is called immediately.
+// Arguments:
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct that receives
+//                                       the date and time, must stay valid until done is called
+//  - void (*done)(uint8_t status): called (from the TWI interrupt) when pDateTime is filled
+//                                  in, status has the same meaning as the return value of
+//                                  DS3231_ReadDateTime. May be 0.
+//
+// Returns:
+//  - 0: if the read was started
+//  - 2: if the transaction queue is full, try again later
+uint8_t DS3231_ReadDateTimeAsync(struct DS3231_DateTime* pDateTime, void (*done)(uint8_t status))
+{
+  DS3231_STATS_FUNC(DS3231_FN_READ_DATE_TIME_ASYNC);
+  if(soft_active)
   {
-    ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, MONTH_ADDRESS, &buf);
-    if(ret != 0)
-      return ret;
-    else
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-      *month = (buf&0x0F) + (((buf&0x10)>>4)*10);
+      *pDateTime = *(struct DS3231_DateTime*)&soft_time;
     }
-    #ifdef DEBUG_DS3231
-      USART_PrintString("month succesfully read\n");
-    #endif
+    if(done != 0)
+      done(0);
+    return 0;
   }
+  return DS3231_Bus_ReadAsync(SECONDS_ADDRESS, (uint8_t*)pDateTime, 7, DS3231_DecodeDateTimeInPlace, done);
+}
 
-  if(year != 0)
+////////////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_WriteAlarm1
+// Description: This function writes the register image of alarm 1 in one burst, the write
+//              is skipped when the shadow copy shows that the registers already hold it.
+// Arguments:
+//  - const uint8_t* buf: the values of registers 0x07 to 0x0A
+//
+// Returns:
+//  - 0: if the registers were succesfully written (or already held the values)
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors
+static uint8_t DS3231_WriteAlarm1(const uint8_t* buf)
+{
+  if((shadow_valid & SHADOW_ALARM1_VALID) && memcmp(buf, shadow_alarm1, 4) == 0)
+    return 0; // the DS3231 already holds this alarm
+  uint8_t ret = DS3231_Bus_Write(ALARM1_SEC_ADDRESS, buf, 4); // write all alarm 1 registers in one transaction
+  if(ret != 0)
   {
-    ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, YEAR_ADDRESS, &buf);
-    if(ret != 0)
-      return ret;
-    else
-    {
-      *year = (buf&0x0F) + (((buf&0xF0)>>4)*10);
-    }
-  #ifdef DEBUG_DS3231
-    USART_PrintString("year succesfully read\n");
-  #endif
+    shadow_valid &= ~SHADOW_ALARM1_VALID; // the registers may or may not have been written
+    return ret;
   }
-
+  memcpy(shadow_alarm1, buf, 4);
+  shadow_valid |= SHADOW_ALARM1_VALID;
   return 0;
+}
 
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_WriteAlarm2
+// Description: This function writes the register image of alarm 2 in one burst, the write
+//              is skipped when the shadow copy shows that the registers already hold it.
+// Arguments:
+//  - const uint8_t* buf: the values of registers 0x0B to 0x0D
+//
+// Returns: see DS3231_WriteAlarm1
+static uint8_t DS3231_WriteAlarm2(const uint8_t* buf)
+{
+  if((shadow_valid & SHADOW_ALARM2_VALID) && memcmp(buf, shadow_alarm2, 3) == 0)
+    return 0; // the DS3231 already holds this alarm
+  uint8_t ret = DS3231_Bus_Write(ALARM2_MIN_ADDRESS, buf, 3); // write all alarm 2 registers in one transaction
+  if(ret != 0)
+  {
+    shadow_valid &= ~SHADOW_ALARM2_VALID; // the registers may or may not have been written
+    return ret;
+  }
+  memcpy(shadow_alarm2, buf, 3);
+  shadow_valid |= SHADOW_ALARM2_VALID;
+  return 0;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////
 // Name: DS3231_SetAlarm1
 // Description: This function sets Alarm 1. With the parameters (seconds, minutes, etc..) the
 //              exact time alarm 1 should trigger can be configured, see Arguments for valid values.
@@ -317,6 +656,8 @@ uint8_t DS3231_ReadDate(uint8_t* day_of_month, uint8_t* month, uint8_t* year)
 //              - 5. seconds, minutes, hours, day_of_month normal values, day 255: Alarm 1 triggers each time
 //                   seconds, minutes, hours and day of month match the timer (monthly interval).
 //              - 6. Each parameter 255: alarm 1 triggers every second.
+//              All parameters are validated before anything is written, the four alarm 1
+//              registers are then written in one burst transaction.
 //
 // Arguments:
 //  - uint8_t seconds: the second on which alarm 1 should trigger. This parameter can have
@@ -336,82 +677,132 @@ uint8_t DS3231_ReadDate(uint8_t* day_of_month, uint8_t* month, uint8_t* year)
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_SetAlarm1(uint8_t seconds, uint8_t minutes, uint8_t hours, uint8_t day, uint8_t day_of_month)
 {
-  uint8_t ret;
+  DS3231_STATS_FUNC(DS3231_FN_SET_ALARM1);
+  uint8_t buf[4]; // register image of 0x07 to 0x0A, only written after all parameters are validated
+
   if(seconds < 60)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_SEC_ADDRESS, ((seconds%10) | ((seconds/10)<<4)));
-    if(ret != 0)
-      return ret;
-  }
+    buf[0] = DS3231_EncodeBCD(seconds);
   else if(seconds == 255)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_SEC_ADDRESS, 0x80); // writes a 1 to bit 7 (A1M1)
-    if(ret != 0)
-      return ret;
-  }
+    buf[0] = 0x80; // a 1 in bit 7 (A1M1) so the alarm doesnt use the seconds for the alarm
   else
     return 2; // signal that an invalid value has been given to the seconds parameter
 
   if(minutes < 60)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_MIN_ADDRESS, ((minutes%10) | ((minutes/10)<<4)));
-    if(ret != 0)
-      return ret;
-  }
+    buf[1] = DS3231_EncodeBCD(minutes);
   else if(minutes == 255)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_MIN_ADDRESS, 0x80); // writes a 1 to bit 7 (A1M2) so the alarm doesnt use the minutes for the alarm
-    if(ret != 0)
-      return ret;
-  }
+    buf[1] = 0x80; // a 1 in bit 7 (A1M2) so the alarm doesnt use the minutes for the alarm
   else
     return 3; // signal that an invalid value has been given to the minutes parameter
 
   if(hours < 24)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_HOUR_ADDRESS, ((hours%10) | ((hours/10)<<4)));
-    if(ret != 0)
-      return ret;
-  }
+    buf[2] = DS3231_EncodeBCD(hours);
   else if(hours == 255)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_HOUR_ADDRESS, 0x80); // writes a 1 to bit 7 (A1M3) so the alarm doesnt use the hours for the alarm
-    if(ret != 0)
-      return ret;
-  }
+    buf[2] = 0x80; // a 1 in bit 7 (A1M3) so the alarm doesnt use the hours for the alarm
   else
     return 4; // signal that an invalid value has been given to the hours parameter
 
   if(day <= 7 && day_of_month <= 31)
     return 5; // signal than an ambigous values has been given to the parameters day and day_of_month: not clear wheter alarm should trigger every day of week or every day of month
   else if(day <= 7 && day_of_month == 255) // in this case the day of the week will be used for the alarm
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_DYDT_ADDRESS, day | 0x40); // write the day to the register and write a 1 to the DY/DT bit to indicate that the value written indicates the day of the week
-    if(ret != 0)
-      return ret;
-  }
+    buf[3] = day | 0x40; // the day and a 1 in the DY/DT bit to indicate that the value indicates the day of the week
   else if(day == 255 && day_of_month <= 31) // in this case the day of the month will be used for the alarm
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_DYDT_ADDRESS, ((day_of_month%10) | ((day_of_month/10)<<4)) ); // write the day to the register and write a 0 to the DY/DT bit to indicate that the value written indicates the day of the month
-    if(ret != 0)
-      return ret;
-  }
+    buf[3] = DS3231_EncodeBCD(day_of_month); // the day and a 0 in the DY/DT bit to indicate that the value indicates the day of the month
   else if(day == 255 && day_of_month == 255) //in this case day of week or day of month will not be used for the alarm
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM1_DYDT_ADDRESS, 0x80); // write a 1 to bit 7 (A1M4) to indicate to not use the day of week/month for the alarm
-    if(ret != 0)
-      return ret;
-  }
+    buf[3] = 0x80; // a 1 in bit 7 (A1M4) to indicate to not use the day of week/month for the alarm
   else // other values are invalid
     return 6; // signal than invalid values for both or one of the parameters is given
 
-  return 0; // signal alarm 1 has been set succesfully
+  return DS3231_WriteAlarm1(buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetAlarm1Spec
+// Description: This function programs alarm 1 from a specification built at compile time
+//              with DS3231_ALARM1_SPEC or DS3231_ALARM1_SPEC_RAW (see DS3231.h). The register
+//              image is written as it is in one burst, nothing is encoded or validated.
+// Arguments:
+//  - const struct DS3231_Alarm1Spec* pSpec: pointer to the specification (in RAM)
+//
+// Returns:
+//  - 0: if alarm 1 was succesfully set
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SetAlarm1Spec(const struct DS3231_Alarm1Spec* pSpec)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_ALARM1_SPEC);
+  return DS3231_WriteAlarm1(pSpec->reg);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetAlarm1Spec_P
+// Description: This function programs alarm 1 from a specification in flash (PROGMEM),
+//              see DS3231_SetAlarm1Spec.
+// Arguments:
+//  - const struct DS3231_Alarm1Spec* pSpec: pointer to the specification in flash
+//
+// Returns: see DS3231_SetAlarm1Spec
+uint8_t DS3231_SetAlarm1Spec_P(const struct DS3231_Alarm1Spec* pSpec)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_ALARM1_SPEC_P);
+  uint8_t buf[4];
+  memcpy_P(buf, pSpec->reg, 4);
+  return DS3231_WriteAlarm1(buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadStatus
+// Description: This function reads the status register and refreshes the shadow copy of
+//              its EN32kHz bit.
+// Arguments:
+//  - uint8_t* status: pointer to a uint8_t variable to store the status register
+//
+// Returns:
+//  - 0: if the status register was succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors
+static uint8_t DS3231_ReadStatus(uint8_t* status)
+{
+  uint8_t ret = DS3231_Bus_Read(STATUS_ADDRESS, status, 1);
+  if(ret != 0)
+    return ret;
+  shadow_en32k = *status & STATUS_EN32KHZ;
+  shadow_valid |= SHADOW_STATUS_VALID;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_WriteStatus
+// Description: This function clears flags in the status register with a single write.
+//              OSF, A2F and A1F can only be cleared by the host (writing a 1 leaves them
+//              unchanged) and BSY is read only, so with the shadow copy of EN32kHz the
+//              register can be written without reading it first. Only when the shadow is
+//              invalid the register is read once.
+// Arguments:
+//  - uint8_t clear: mask of the flags to clear (OSF 0x80, A2F 0x02, A1F 0x01)
+//
+// Returns:
+//  - 0: if the status register was succesfully written
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors
+static uint8_t DS3231_WriteStatus(uint8_t clear)
+{
+  uint8_t ret, buf;
+  if(!(shadow_valid & SHADOW_STATUS_VALID))
+  {
+    ret = DS3231_ReadStatus(&buf);
+    if(ret != 0)
+      return ret;
+  }
+  buf = (STATUS_KEEP_FLAGS & ~clear) | shadow_en32k;
+  return DS3231_Bus_Write(STATUS_ADDRESS, &buf, 1);
 }
 
 uint8_t DS3231_ReadAlarm1Flag(void)
 {
+  DS3231_STATS_FUNC(DS3231_FN_READ_ALARM1_FLAG);
   uint8_t ret, buf;
-  ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, STATUS_ADDRESS, &buf);
+  ret = DS3231_ReadStatus(&buf);
   if(ret == 1)
     return 2; // signal a timeout error
   if(ret != 0) // else it is a TWI error code
@@ -425,24 +816,15 @@ uint8_t DS3231_ReadAlarm1Flag(void)
 
 uint8_t DS3231_ClearAlarm1Flag(void)
 {
-  uint8_t ret, buf;
-  ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, STATUS_ADDRESS, &buf); // read the status register
-  if(ret != 0) // else it is a TWI error code
-    return ret; // signal the TWI error code
-
-  buf = buf & 0b11111110; // clear the alarm 1 flag in the status register
-
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, STATUS_ADDRESS, buf); // write the status reg back
-  if(ret != 0)
-    return ret;
-
-  return 0; // signal that the alarm 1 flag has been succesfully cleared
+  DS3231_STATS_FUNC(DS3231_FN_CLEAR_ALARM1_FLAG);
+  return DS3231_WriteStatus(0b00000001); // clear the alarm 1 flag, all other bits unchanged
 }
 
 uint8_t DS3231_ReadAlarm2Flag(void)
 {
+  DS3231_STATS_FUNC(DS3231_FN_READ_ALARM2_FLAG);
   uint8_t ret, buf;
-  ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, STATUS_ADDRESS, &buf);
+  ret = DS3231_ReadStatus(&buf);
   if(ret == 1)
     return 2; // signal a timeout error
   if(ret != 0) // else it is a TWI error code
@@ -456,18 +838,40 @@ uint8_t DS3231_ReadAlarm2Flag(void)
 
 uint8_t DS3231_ClearAlarm2Flag(void)
 {
-  uint8_t ret, buf;
-  ret = I2C_Read_From_Slave(DS3231_I2C_ADDRESS, STATUS_ADDRESS, &buf); // read the status register
-  if(ret != 0) // else it is a TWI error code
-    return ret; // signal the TWI error code
-
-  buf = buf & 0b11111101; // clear the alarm 2 flag in the status register
+  DS3231_STATS_FUNC(DS3231_FN_CLEAR_ALARM2_FLAG);
+  return DS3231_WriteStatus(0b00000010); // clear the alarm 2 flag, all other bits unchanged
+}
 
-  ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, STATUS_ADDRESS, buf); // write the status reg back
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ServiceInterrupt
+// Description: This function services the INT pin of the DS3231: it reads the status
+//              register once, returns the flags and clears the alarm flags that fired with a
+//              single write (only when an alarm fired). OSF is reported but not cleared.
+// Arguments:
+//  - uint8_t* fired_mask: pointer to a uint8_t variable to store the flags of the status
+//                         register: DS3231_FLAG_A1F, DS3231_FLAG_A2F, DS3231_FLAG_BSY and
+//                         DS3231_FLAG_OSF (may be 0)
+//
+// Returns:
+//  - 0: if the status register was succesfully read (and the fired alarm flags cleared)
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ServiceInterrupt(uint8_t* fired_mask)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SERVICE_INTERRUPT);
+  uint8_t ret, status, fired;
+  ret = DS3231_ReadStatus(&status);
   if(ret != 0)
     return ret;
 
-  return 0; // signal that the alarm 2 flag has been succesfully cleared
+  if(fired_mask != 0)
+    *fired_mask = status & (DS3231_FLAG_A1F | DS3231_FLAG_A2F | DS3231_FLAG_BSY | DS3231_FLAG_OSF);
+
+  fired = status & (DS3231_FLAG_A1F | DS3231_FLAG_A2F);
+  if(fired == 0)
+    return 0;
+  return DS3231_WriteStatus(fired); // the shadow is valid after the read, so this is a single write
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -485,6 +889,8 @@ uint8_t DS3231_ClearAlarm2Flag(void)
 //              - 4. minutes, hours, day_of_month normal values, day 255: Alarm 2 triggers each time
 //                   minutes AND hours AND day of month match the timer (monthly interval).
 //              - 5. Each parameter 255: alarm 2 triggers every minute.
+//              All parameters are validated before anything is written, the three alarm 2
+//              registers are then written in one burst transaction.
 //
 // Arguments:
 //  - uint8_t minutes: the minute on which alarm 1 should trigger. This parameter can have
@@ -502,59 +908,806 @@ uint8_t DS3231_ClearAlarm2Flag(void)
 //          ATmega328 datasheet for the meaning of the code
 uint8_t DS3231_SetAlarm2(uint8_t minutes, uint8_t hours, uint8_t day, uint8_t day_of_month)
 {
-  uint8_t ret;
+  DS3231_STATS_FUNC(DS3231_FN_SET_ALARM2);
+  uint8_t buf[3]; // register image of 0x0B to 0x0D, only written after all parameters are validated
+
   if(minutes < 60)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_MIN_ADDRESS, ((minutes%10) | ((minutes/10)<<4)));
-    if(ret != 0)
-      return ret;
-  }
+    buf[0] = DS3231_EncodeBCD(minutes);
   else if(minutes == 255)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_MIN_ADDRESS, 0x80); // writes a 1 to bit 7 (A1M2) so the alarm doesnt use the minutes for the alarm
-    if(ret != 0)
-      return ret;
-  }
+    buf[0] = 0x80; // a 1 in bit 7 (A2M2) so the alarm doesnt use the minutes for the alarm
   else
     return 3; // signal that an invalid value has been given to the minutes parameter
 
   if(hours < 24)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_HOUR_ADDRESS, ((hours%10) | ((hours/10)<<4)));
-    if(ret != 0)
-      return ret;
-  }
+    buf[1] = DS3231_EncodeBCD(hours);
   else if(hours == 255)
-  {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_HOUR_ADDRESS, 0x80); // writes a 1 to bit 7 (A1M3) so the alarm doesnt use the hours for the alarm
-    if(ret != 0)
-      return ret;
-  }
+    buf[1] = 0x80; // a 1 in bit 7 (A2M3) so the alarm doesnt use the hours for the alarm
   else
     return 4; // signal that an invalid value has been given to the hours parameter
 
   if(day <= 7 && day_of_month <= 31)
     return 5; // signal than an ambigous values has been given to the parameters day and day_of_month: not clear wheter alarm should trigger every day of week or every day of month
   else if(day <= 7 && day_of_month == 255) // in this case the day of the week will be used for the alarm
+    buf[2] = day | 0x40; // the day and a 1 in the DY/DT bit to indicate that the value indicates the day of the week
+  else if(day == 255 && day_of_month <= 31) // in this case the day of the month will be used for the alarm
+    buf[2] = DS3231_EncodeBCD(day_of_month); // the day and a 0 in the DY/DT bit to indicate that the value indicates the day of the month
+  else if(day == 255 && day_of_month == 255) //in this case day of week and day of month will not be used for the alarm
+    buf[2] = 0x80; // a 1 in bit 7 (A2M4) to indicate to not use the day of week/month for the alarm
+  else // other values are invalid
+    return 6; // signal than invalid values for both or one of the parameters is given
+
+  return DS3231_WriteAlarm2(buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetAlarm2Spec
+// Description: This function programs alarm 2 from a specification built at compile time
+//              with DS3231_ALARM2_SPEC or DS3231_ALARM2_SPEC_RAW (see DS3231.h). The register
+//              image is written as it is in one burst, nothing is encoded or validated.
+// Arguments:
+//  - const struct DS3231_Alarm2Spec* pSpec: pointer to the specification (in RAM)
+//
+// Returns:
+//  - 0: if alarm 2 was succesfully set
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SetAlarm2Spec(const struct DS3231_Alarm2Spec* pSpec)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_ALARM2_SPEC);
+  return DS3231_WriteAlarm2(pSpec->reg);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetAlarm2Spec_P
+// Description: This function programs alarm 2 from a specification in flash (PROGMEM),
+//              see DS3231_SetAlarm2Spec.
+// Arguments:
+//  - const struct DS3231_Alarm2Spec* pSpec: pointer to the specification in flash
+//
+// Returns: see DS3231_SetAlarm2Spec
+uint8_t DS3231_SetAlarm2Spec_P(const struct DS3231_Alarm2Spec* pSpec)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_ALARM2_SPEC_P);
+  uint8_t buf[3];
+  memcpy_P(buf, pSpec->reg, 3);
+  return DS3231_WriteAlarm2(buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DaysInMonth
+// Description: This function returns the number of days in a month (years 2000 to 2199).
+// Arguments:
+//  - uint8_t month: the month (1 to 12)
+//  - uint8_t year: the year (0 to 199)
+//
+// Returns: the number of days in the month
+static uint8_t DS3231_DaysInMonth(uint8_t month, uint8_t year)
+{
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if(month == 2 && DS3231_IS_LEAP(year))
+    return 29;
+  return days[month-1];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_AdvanceSecond
+// Description: This function advances a date and time by one second (2199-12-31 23:59:59
+//              wraps to 2000-01-01 00:00:00).
+// Arguments:
+//  - volatile struct DS3231_DateTime* t: the date and time (the RAM copy of the software
+//                                        clock or a local copy)
+//
+// Returns: nothing
+static void DS3231_AdvanceSecond(volatile struct DS3231_DateTime* t)
+{
+  if(++t->seconds < 60)
+    return;
+  t->seconds = 0;
+  if(++t->minutes < 60)
+    return;
+  t->minutes = 0;
+  if(++t->hours < 24)
+    return;
+  t->hours = 0;
+  if(++t->day > 7)
+    t->day = 1;
+  if(++t->day_of_month <= DS3231_DaysInMonth(t->month, t->year))
+    return;
+  t->day_of_month = 1;
+  if(++t->month <= 12)
+    return;
+  t->month = 1;
+  if(++t->year > 199)
+    t->year = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SoftClock_Sync
+// Description: This function loads the RAM copy of the software clock with the date and
+//              time of the DS3231. In case a 1 Hz edge occurs during the bus read the read
+//              is repeated, so the RAM copy always belongs to the current second.
+// Arguments: none
+//
+// Returns:
+//  - 0: if the RAM copy was succesfully loaded
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+static uint8_t DS3231_SoftClock_Sync(void)
+{
+  struct DS3231_DateTime dt;
+  uint8_t ret, edges, done = 0;
+
+  while(!done)
   {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_DYDT_ADDRESS, day | 0x40); // write the day to the register and write a 1 to the DY/DT bit to indicate that the value written indicates the day of the week
+    edges = soft_edges;
+    ret = DS3231_FetchDateTime(&dt);
     if(ret != 0)
       return ret;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      if(edges == soft_edges) // no edge occured during the read
+      {
+        *(struct DS3231_DateTime*)&soft_time = dt;
+        soft_ticks_since_sync = 0;
+        done = 1;
+      }
+    }
   }
-  else if(day == 255 && day_of_month <= 31) // in this case the day of the month will be used for the alarm
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SoftClock_Start
+// Description: This function starts the software clock. The date and time are read once
+//              from the DS3231, after that DS3231_SoftClock_Tick advances a RAM copy on
+//              every edge of the 1 Hz square wave and DS3231_ReadDateTime, DS3231_ReadTime
+//              and DS3231_ReadDate are served from RAM without bus traffic.
+//              Requirements:
+//              - the DS3231 must output the 1 Hz square wave (SquareWaveOrInterrupt =
+//                SQUAREWAVE_FUNC and SquareWaveFreq = SWFREQ_1HZ in the DS3231_Init_Struct)
+//              - DS3231_SoftClock_Tick must be called from the interrupt (e.g. INT0 or a pin
+//                change interrupt) that fires on the falling edge of the square wave, on this
+//                edge the seconds register of the DS3231 increments
+//              - DS3231_SoftClock_Service must be called regularly from the main loop
+// Arguments:
+//  - uint16_t resync_period: number of seconds after which DS3231_SoftClock_Service reads
+//                            the DS3231 again to check and correct the RAM copy, 0 disables
+//                            the periodic resync
+//
+// Returns:
+//  - 0: if the software clock was succesfully started
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SoftClock_Start(uint16_t resync_period)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SOFT_CLOCK_START);
+  soft_active = 0;
+  soft_resync_period = resync_period;
+  soft_drift_count = 0;
+  soft_last_drift = 0;
+
+  uint8_t ret = DS3231_SoftClock_Sync();
+  if(ret != 0)
+    return ret;
+  soft_active = 1;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SoftClock_Stop
+// Description: This function stops the software clock, the date and time are read from
+//              the DS3231 again.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_SoftClock_Stop(void)
+{
+  soft_active = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SoftClock_Tick
+// Description: This function advances the RAM copy of the software clock by one second.
+//              It must be called from the interrupt service routine of the 1 Hz edge, it
+//              does no bus traffic.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_SoftClock_Tick(void)
+{
+  soft_edges++;
+  if(!soft_active)
+    return;
+  soft_ticks_since_sync++;
+  DS3231_AdvanceSecond(&soft_time);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SoftClock_Service
+// Description: This function does the periodic resync of the software clock, it must be
+//              called regularly from the main loop. When the resync period has elapsed the
+//              date and time are read from the DS3231 and compared with the RAM copy. A
+//              difference (e.g. caused by a missed edge) is counted, stored (see
+//              DS3231_SoftClock_GetDrift) and corrected.
+// Arguments: none
+//
+// Returns:
+//  - 0: if no resync was due or the RAM copy matched the DS3231
+//  - 2: if the RAM copy differed from the DS3231, the RAM copy has been corrected
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SoftClock_Service(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SOFT_CLOCK_SERVICE);
+  struct DS3231_DateTime dt, ram;
+  uint8_t ret, edges, drift = 0;
+
+  if(!soft_active || soft_resync_period == 0 || soft_ticks_since_sync < soft_resync_period)
+    return 0;
+
+  edges = soft_edges;
+  ret = DS3231_FetchDateTime(&dt);
+  if(ret != 0)
+    return ret;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
   {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_DYDT_ADDRESS, ((day_of_month%10) | ((day_of_month/10)<<4)) ); // write the day to the register and write a 0 to the DY/DT bit to indicate that the value written indicates the day of the month
-    if(ret != 0)
-      return ret;
+    if(edges == soft_edges) // else an edge occured during the read, try again on the next call
+    {
+      ram = *(struct DS3231_DateTime*)&soft_time;
+      if(ram.seconds != dt.seconds || ram.minutes != dt.minutes || ram.hours != dt.hours || ram.day != dt.day ||
+         ram.day_of_month != dt.day_of_month || ram.month != dt.month || ram.year != dt.year)
+      {
+        *(struct DS3231_DateTime*)&soft_time = dt;
+        drift = 1;
+      }
+      soft_ticks_since_sync = 0;
+    }
   }
-  else if(day == 255 && day_of_month == 255) //in this case day of week and day of month will not be used for the alarm
+  if(!drift)
+    return 0;
+
+  // difference in seconds within the day, a difference in the date is reported as the time of day difference
+  int32_t diff = ((int32_t)dt.hours*3600 + dt.minutes*60 + dt.seconds) - ((int32_t)ram.hours*3600 + ram.minutes*60 + ram.seconds);
+  if(diff > 43200)
+    diff -= 86400;
+  else if(diff < -43200)
+    diff += 86400;
+  soft_last_drift = diff;
+  soft_drift_count++;
+  DS3231_TRACE_EVENT(DS3231_EV_SOFT_DRIFT, 0, (uint8_t)(int8_t)((diff > 127) ? 127 : ((diff < -128) ? -128 : diff)));
+  return 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SoftClock_GetDrift
+// Description: This function returns the drift statistics of the software clock.
+// Arguments:
+//  - uint16_t* count: pointer to a uint16_t variable to store the number of resyncs on
+//                     which the RAM copy differed from the DS3231 (may be 0)
+//  - int32_t* last_drift: pointer to a int32_t variable to store the difference (DS3231
+//                         minus RAM copy, in seconds) found on the last resync with drift,
+//                         e.g. 1 for a missed edge (may be 0)
+//
+// Returns: nothing
+void DS3231_SoftClock_GetDrift(uint16_t* count, int32_t* last_drift)
+{
+  if(count != 0)
+    *count = soft_drift_count;
+  if(last_drift != 0)
+    *last_drift = soft_last_drift;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Enable32kHzOutput
+// Description: This function enables or disables the 32.768 kHz output (pin 1) of the
+//              DS3231 with the EN32kHz bit of the status register.
+// Arguments:
+//  - uint8_t enable: 1 to enable the 32kHz output, 0 to disable it
+//
+// Returns:
+//  - 0: if the status register was succesfully written
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Enable32kHzOutput(uint8_t enable)
+{
+  DS3231_STATS_FUNC(DS3231_FN_ENABLE_32KHZ_OUTPUT);
+  // writing a 1 to OSF, A2F and A1F leaves these flags unchanged and BSY is read only, so the
+  // status register can be written without reading it first
+  uint8_t buf = STATUS_KEEP_FLAGS;
+  if(enable)
+    buf |= STATUS_EN32KHZ;
+
+  uint8_t ret = DS3231_Bus_Write(STATUS_ADDRESS, &buf, 1);
+  if(ret != 0)
+  {
+    shadow_valid &= ~SHADOW_STATUS_VALID;
+    return ret;
+  }
+  shadow_en32k = buf & STATUS_EN32KHZ;
+  shadow_valid |= SHADOW_STATUS_VALID;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ModifyControl
+// Description: This function changes fields of the control register. The new value is
+//              computed from the shadow copy and written with a single write, the register
+//              is only read when the shadow copy is invalid (before DS3231_Init or after
+//              DS3231_InvalidateCache).
+// Arguments:
+//  - uint8_t mask: mask of the bits to change, see the defines of the DS3231_Init_Struct
+//  - uint8_t bits: new value of the bits in mask
+//
+// Returns:
+//  - 0: if the control register was succesfully written
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ModifyControl(uint8_t mask, uint8_t bits)
+{
+  DS3231_STATS_FUNC(DS3231_FN_MODIFY_CONTROL);
+  uint8_t ret, buf;
+  if(!(shadow_valid & SHADOW_CTRL_VALID))
   {
-    ret = I2C_Write_To_Slave(DS3231_I2C_ADDRESS, ALARM2_DYDT_ADDRESS, 0x80); // write a 1 to bit 7 (A1M4) to indicate to not use the day of week/month for the alarm
+    ret = DS3231_Bus_Read(CTRL_ADDRESS, &buf, 1);
     if(ret != 0)
       return ret;
+    shadow_ctrl = buf & ~CTRL_CONV;
+    shadow_valid |= SHADOW_CTRL_VALID;
   }
-  else // other values are invalid
-    return 6; // signal than invalid values for both or one of the parameters is given
 
-  return 0; // signal alarm 1 has been set succesfully
+  buf = (shadow_ctrl & ~mask) | (bits & mask);
+  ret = DS3231_Bus_Write(CTRL_ADDRESS, &buf, 1);
+  if(ret != 0)
+  {
+    shadow_valid &= ~SHADOW_CTRL_VALID;
+    return ret;
+  }
+  shadow_ctrl = buf & ~CTRL_CONV;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_InvalidateCache
+// Description: This function invalidates the shadow copies of the control, status and alarm
+//              registers, the next access reads them from the DS3231 again (the alarm setters
+//              write again). Call it when the
+//              DS3231 may have changed without the lib (e.g. after a power loss of the DS3231,
+//              a brown-out or a reset of the DS3231).
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_InvalidateCache(void)
+{
+  shadow_valid = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DecodeTemp
+// Description: This function converts the temperature registers (10 bit two's complement,
+//              0.25 degree resolution) to hundredths of a degree Celsius.
+// Arguments:
+//  - uint8_t msb: register 0x11 (integer part, signed)
+//  - uint8_t lsb: register 0x12 (fraction in bits 7 and 6)
+//
+// Returns: the temperature in 0.01 degree Celsius
+static int16_t DS3231_DecodeTemp(uint8_t msb, uint8_t lsb)
+{
+  return (int16_t)(int8_t)msb*100 + (lsb >> 6)*25;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_StartTempConversion
+// Description: This function starts a temperature conversion (and a new calculation of the
+//              capacitance array) by setting the CONV bit of the control register. The
+//              function does not wait, poll the result with DS3231_PollTemp (a conversion
+//              takes up to 200 ms). The other bits of the control register are written from
+//              the shadow copy, CONV is never kept in the shadow.
+// Arguments: none
+//
+// Returns:
+//  - 0: if the conversion was started
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: if a conversion is in progress (BSY set, e.g. the automatic conversion every 64 s),
+//       nothing is written
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_StartTempConversion(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_START_TEMP_CONVERSION);
+  uint8_t status;
+  uint8_t ret = DS3231_ReadStatus(&status);
+  if(ret != 0)
+    return ret;
+  if(status & DS3231_FLAG_BSY)
+    return 2;
+  return DS3231_ModifyControl(CTRL_CONV, CTRL_CONV);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_PollTemp
+// Description: This function reads the control, status and temperature registers (0x0E to
+//              0x12) in one burst and returns the temperature when no conversion is in
+//              progress (CONV and BSY both clear). It never waits. The shadow copies of the
+//              control and status registers are refreshed by the read.
+// Arguments:
+//  - int16_t* centi_celsius: pointer to a int16_t variable to store the temperature in
+//                            0.01 degree Celsius (-12800 to 12775, 25 steps)
+//
+// Returns:
+//  - 0: if the temperature was read
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: if a conversion is still in progress (centi_celsius is not changed)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_PollTemp(int16_t* centi_celsius)
+{
+  DS3231_STATS_FUNC(DS3231_FN_POLL_TEMP);
+  uint8_t buf[5]; // control, status, aging offset, temperature MSB and LSB
+  uint8_t ret = DS3231_Bus_Read(CTRL_ADDRESS, buf, 5);
+  if(ret != 0)
+    return ret;
+
+  shadow_ctrl = buf[0] & ~CTRL_CONV;
+  shadow_en32k = buf[1] & STATUS_EN32KHZ;
+  shadow_valid |= SHADOW_CTRL_VALID | SHADOW_STATUS_VALID; // the alarm shadows stay as they are
+  if((buf[0] & CTRL_CONV) || (buf[1] & DS3231_FLAG_BSY))
+    return 2;
+  *centi_celsius = DS3231_DecodeTemp(buf[3], buf[4]);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadTempAndStatus
+// Description: This function reads the status and temperature registers (0x0F to 0x12) in
+//              one burst. The temperature is the result of the last completed conversion
+//              (the DS3231 converts automatically every 64 s), the status register tells
+//              whether an alarm fired, a conversion is running or the oscillator stopped. The
+//              flags are not cleared (see DS3231_ServiceInterrupt).
+// Arguments:
+//  - int16_t* centi_celsius: pointer to a int16_t variable to store the temperature in
+//                            0.01 degree Celsius
+//  - uint8_t* status: pointer to a uint8_t variable to store the status register (see the
+//                     DS3231_FLAG_ defines), may be 0
+//
+// Returns:
+//  - 0: if the registers were succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ReadTempAndStatus(int16_t* centi_celsius, uint8_t* status)
+{
+  DS3231_STATS_FUNC(DS3231_FN_READ_TEMP_AND_STATUS);
+  uint8_t buf[4]; // status, aging offset, temperature MSB and LSB
+  uint8_t ret = DS3231_Bus_Read(STATUS_ADDRESS, buf, 4);
+  if(ret != 0)
+    return ret;
+
+  shadow_en32k = buf[0] & STATUS_EN32KHZ;
+  shadow_valid |= SHADOW_STATUS_VALID;
+  *centi_celsius = DS3231_DecodeTemp(buf[2], buf[3]);
+  if(status != 0)
+    *status = buf[0];
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadAgingOffset
+// Description: This function reads the aging offset register (0x10).
+// Arguments:
+//  - int8_t* offset: pointer to a int8_t variable to store the aging offset (-128 to 127,
+//                    one step is about 0.1 ppm, see DS3231_SetAgingOffset)
+//
+// Returns:
+//  - 0: if the register was succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ReadAgingOffset(int8_t* offset)
+{
+  DS3231_STATS_FUNC(DS3231_FN_READ_AGING_OFFSET);
+  uint8_t buf;
+  uint8_t ret = DS3231_Bus_Read(AGING_ADDRESS, &buf, 1);
+  if(ret == 0)
+    *offset = (int8_t)buf;
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetAgingOffset
+// Description: This function writes the aging offset register (0x10) and starts a
+//              temperature conversion, the new offset is only applied to the oscillator by
+//              the next conversion. A positive offset adds capacitance to the crystal and
+//              slows the clock down, one step is about 0.1 ppm at 25 degree Celsius (about
+//              0.26 s per month).
+// Arguments:
+//  - int8_t offset: the aging offset (-128 to 127), 0 is the factory setting
+//
+// Returns:
+//  - 0: if the register was written (also when a conversion was already in progress, the
+//       automatic conversion applies the offset then)
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SetAgingOffset(int8_t offset)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_AGING_OFFSET);
+  uint8_t buf = (uint8_t)offset;
+  uint8_t ret = DS3231_Bus_Write(AGING_ADDRESS, &buf, 1);
+  if(ret != 0)
+    return ret;
+  ret = DS3231_StartTempConversion();
+  return (ret == 2) ? 0 : ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_GetBusFrequency
+// Description: This function returns the SCL frequency that was achieved by DS3231_Init.
+//              Because of the granularity of the TWBR register and prescaler this can be
+//              lower than the requested bus speed, it is never higher.
+// Arguments: none
+//
+// Returns: the SCL frequency in Hz, 0 if the bus has not been initialized
+uint32_t DS3231_GetBusFrequency(void)
+{
+  return DS3231_Bus_GetFrequency();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetRetryPolicy
+// Description: This function sets how often a failed read or write of the DS3231 is
+//              repeated before the error is returned. All functions of the lib that wait for
+//              the bus use this policy. The first retry waits backoff_us, every further retry
+//              twice as long; a timeout or bus error also recovers the bus before the retry
+//              (see DS3231_PutInKnownI2CState). The default is 2 retries starting at 100 us.
+//              DS3231_ReadDateTimeAsync reports errors without retrying.
+// Arguments:
+//  - uint8_t retries: number of retries after the first attempt, 0 disables retrying
+//  - uint16_t backoff_us: wait before the first retry in us
+//
+// Returns: nothing
+void DS3231_SetRetryPolicy(uint8_t retries, uint16_t backoff_us)
+{
+  DS3231_Bus_SetRetryPolicy(retries, backoff_us);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_GetBusErrors
+// Description: This function returns how often reads and writes were retried, how often
+//              the bus was recovered and how many operations failed after all retries since
+//              the last call of DS3231_ResetBusErrors.
+// Arguments:
+//  - struct DS3231_BusErrors* pErrors: pointer to a DS3231_BusErrors struct to store the counters
+//
+// Returns: nothing
+void DS3231_GetBusErrors(struct DS3231_BusErrors* pErrors)
+{
+  DS3231_Bus_GetErrors(pErrors);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ResetBusErrors
+// Description: This function resets the counters of DS3231_GetBusErrors to zero.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_ResetBusErrors(void)
+{
+  DS3231_Bus_ResetErrors();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DaysBeforeYear
+// Description: This function returns the number of days from 2000-01-01 to the first day
+//              of a year. Every 4th year is a leap year, 2100 is not.
+// Arguments:
+//  - uint8_t year: the year (0 to 200 = 2000 to 2200)
+//
+// Returns: the number of days before the year
+static uint32_t DS3231_DaysBeforeYear(uint8_t year)
+{
+  uint16_t leaps = (uint8_t)(year + 3) >> 2; // 2000, 2004, ... up to and including year-1
+  if(year > 100)
+    leaps--; // 2100
+  return (uint32_t)year*365 + leaps;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DateToDays
+// Description: This function converts a date to the number of days since 2000-01-01.
+// Arguments:
+//  - uint8_t day_of_month: the day of the month (1 to 31)
+//  - uint8_t month: the month (1 to 12)
+//  - uint8_t year: the year (0 to 199)
+//
+// Returns: the number of days since 2000-01-01
+static uint32_t DS3231_DateToDays(uint8_t day_of_month, uint8_t month, uint8_t year)
+{
+  uint16_t doy = days_before_month[month-1] + day_of_month - 1;
+  if(month > 2 && DS3231_IS_LEAP(year))
+    doy++;
+  return DS3231_DaysBeforeYear(year) + doy;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DaysToDate
+// Description: This function converts a number of days since 2000-01-01 to a date and the
+//              day of the week. The year is estimated with (days*179)>>16, which is never
+//              too high and at most one too low within 2000 to 2199, the month is estimated
+//              with doy>>5 and corrected upwards with the cumulative days table (at most 2
+//              steps).
+// Arguments:
+//  - uint32_t days: the number of days since 2000-01-01 (0 to 73048 = 2199-12-31)
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       date (day, day_of_month, month and year)
+//
+// Returns: nothing
+static void DS3231_DaysToDate(uint32_t days, struct DS3231_DateTime* pDateTime)
+{
+  uint8_t year = (uint8_t)((days * 179) >> 16);
+  uint32_t start = DS3231_DaysBeforeYear(year + 1);
+  if(days >= start)
+    year++;
+  else
+    start = DS3231_DaysBeforeYear(year);
+
+  uint16_t doy = days - start;
+  uint8_t leap = DS3231_IS_LEAP(year) ? 1 : 0;
+  uint8_t month = (doy >> 5) + 1;
+  while(month < 12 && doy >= days_before_month[month] + (month >= 2 ? leap : 0))
+    month++;
+  doy -= days_before_month[month-1] + (month > 2 ? leap : 0);
+
+  // days%7 = (year*365 + leap days + day of year)%7 = (year + leap days + day of year)%7,
+  // small enough for the multiply by 9363/65536 (exact for values below 13000)
+  uint16_t w = year + (uint16_t)(start - (uint32_t)year*365) + (days - start) + 5; // 2000-01-01 was a saturday
+  w -= (uint16_t)(((uint32_t)w * 9363) >> 16) * 7;
+
+  pDateTime->day = w + 1;
+  pDateTime->day_of_month = doy + 1;
+  pDateTime->month = month;
+  pDateTime->year = year;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DateTimeToSeconds
+// Description: This function converts a date and time to the number of seconds since
+//              2000-01-01 00:00:00. The day of the week is ignored. The result fits in 32
+//              bits up to 2136-02-07 06:28:15.
+// Arguments:
+//  - const struct DS3231_DateTime* pDateTime: pointer to the date and time to convert
+//
+// Returns: the number of seconds since 2000-01-01 00:00:00
+uint32_t DS3231_DateTimeToSeconds(const struct DS3231_DateTime* pDateTime)
+{
+  uint32_t days = DS3231_DateToDays(pDateTime->day_of_month, pDateTime->month, pDateTime->year);
+  return days*86400 + (uint32_t)pDateTime->hours*3600 + (uint16_t)pDateTime->minutes*60 + pDateTime->seconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SecondsToDateTime
+// Description: This function converts a number of seconds since 2000-01-01 00:00:00 to a
+//              date and time, including the day of the week (monday = 1). The only 32 bit
+//              division is replaced by an estimate from the upper 16 bits, (s>>16)*49710>>16
+//              is never too high and at most 2 days too low, and is corrected by subtraction.
+//              Hours and minutes use exact multiply and shift kernels (rem/3600 =
+//              (rem>>4)*37283>>23, rem/60 = rem*34953>>21 for rem below 86400 and 3600).
+// Arguments:
+//  - uint32_t seconds: the number of seconds since 2000-01-01 00:00:00
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       date and time
+//
+// Returns: nothing
+void DS3231_SecondsToDateTime(uint32_t seconds, struct DS3231_DateTime* pDateTime)
+{
+  uint16_t days = (uint16_t)(((seconds >> 16) * 49710) >> 16);
+  uint32_t rem = seconds - (uint32_t)days*86400;
+  while(rem >= 86400)
+  {
+    rem -= 86400;
+    days++;
+  }
+
+  uint8_t hours = (uint8_t)(((uint32_t)(uint16_t)(rem >> 4) * 37283) >> 23);
+  uint16_t r = (uint16_t)rem - (uint16_t)(hours * 3600U);
+  uint8_t minutes = (uint8_t)(((uint32_t)r * 34953) >> 21);
+
+  pDateTime->seconds = (uint8_t)r - minutes*60;
+  pDateTime->minutes = minutes;
+  pDateTime->hours = hours;
+  DS3231_DaysToDate(days, pDateTime);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_DateTimeToEpoch
+// Description: This function converts a date and time to unix time (seconds since
+//              1970-01-01 00:00:00 UTC). The result is valid from 2000-01-01 00:00:00 up to
+//              2106-02-07 06:28:15, the end of the 32 bit unsigned unix time.
+// Arguments:
+//  - const struct DS3231_DateTime* pDateTime: pointer to the date and time to convert
+//
+// Returns: the unix time
+uint32_t DS3231_DateTimeToEpoch(const struct DS3231_DateTime* pDateTime)
+{
+  return DS3231_DateTimeToSeconds(pDateTime) + DS3231_EPOCH_2000;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_EpochToDateTime
+// Description: This function converts unix time (seconds since 1970-01-01 00:00:00 UTC) to
+//              a date and time, including the day of the week (monday = 1).
+// Arguments:
+//  - uint32_t epoch: the unix time
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       date and time
+//
+// Returns:
+//  - 0: if the time was converted
+//  - 2: if the time is before 2000-01-01 00:00:00, the DS3231 can not represent it
+uint8_t DS3231_EpochToDateTime(uint32_t epoch, struct DS3231_DateTime* pDateTime)
+{
+  if(epoch < DS3231_EPOCH_2000)
+    return 2;
+  DS3231_SecondsToDateTime(epoch - DS3231_EPOCH_2000, pDateTime);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadEpoch
+// Description: This function reads the date and time (from RAM while the software clock
+//              runs, see DS3231_ReadDateTime) and returns it as unix time.
+// Arguments:
+//  - uint32_t* epoch: pointer to a uint32_t variable to store the unix time
+//
+// Returns:
+//  - 0: if the time was succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: if the date of the DS3231 is after 2106-02-07 06:28:15 (end of the 32 bit unix time)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_ReadEpoch(uint32_t* epoch)
+{
+  DS3231_STATS_FUNC(DS3231_FN_READ_EPOCH);
+  struct DS3231_DateTime dt;
+  uint8_t ret = DS3231_ReadDateTime(&dt);
+  if(ret != 0)
+    return ret;
+
+  if(dt.year > 106)
+    return 2;
+  uint32_t seconds = DS3231_DateTimeToSeconds(&dt); // no overflow up to 2136
+  if(seconds > 0xFFFFFFFFUL - DS3231_EPOCH_2000)
+    return 2;
+  *epoch = seconds + DS3231_EPOCH_2000;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SetEpoch
+// Description: This function sets the date and time of the DS3231 from unix time in a
+//              single burst transaction (see DS3231_SetDateTime), the day of the week is
+//              derived from the date.
+// Arguments:
+//  - uint32_t epoch: the unix time to set
+//
+// Returns:
+//  - 0: if date and time were succesfully set
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: if the time is before 2000-01-01 00:00:00
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SetEpoch(uint32_t epoch)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SET_EPOCH);
+  struct DS3231_DateTime dt;
+  if(DS3231_EpochToDateTime(epoch, &dt) != 0)
+    return 2;
+  return DS3231_SetDateTime(&dt);
 }
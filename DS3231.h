@@ -1,8 +1,25 @@
 #ifndef DS3231_LIB_HEADER
 #define DS3231_LIB_HEADER
 
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define DS3231_I2C_ADDRESS 0b11010000 // I2C address of the DS3231 (this address is immutable)
-#define SYSCLOCKFREQ 8000000 // frequency of the system clock
+#ifndef SYSCLOCKFREQ
+#define SYSCLOCKFREQ 8000000 // default frequency of the system clock, used when the CpuFrequency field of the DS3231_Init_Struct is 0
+#endif
+#ifndef DS3231_SQW_PORT
+#define DS3231_SQW_PORT GPIOD // port and pin (Gpio.h) connected to the INT/SQW pin, only used by DS3231_SetDateTimePrecise
+#endif
+#ifndef DS3231_SQW_PIN
+#define DS3231_SQW_PIN GPIO_PIN_2 // PD2 (INT0)
+#endif
+#ifndef DS3231_PRECISE_TOLERANCE_MS
+#define DS3231_PRECISE_TOLERANCE_MS 3 // largest error of the 1 Hz edge accepted by DS3231_SetDateTimePrecise
+#endif
 
 // defines for setting and reading the day of of the week
 #define MONDAY    1
@@ -21,6 +38,59 @@
 #define PER_WEEK    4
 #define PER_MONTH   5
 
+// Alarm specifications: register images of the alarm registers, computed by the compiler from
+// constant arguments. They can be kept in const or PROGMEM tables and are written with one burst
+// by DS3231_SetAlarm1Spec/DS3231_SetAlarm2Spec (_P for PROGMEM) without any encoding or
+// validation at runtime. An argument out of range does not compile (negative array size).
+//   static const struct DS3231_Alarm1Spec wake PROGMEM = DS3231_ALARM1_SPEC(PER_DAY, 0, 30, 6, 0);
+//   DS3231_SetAlarm1Spec_P(&wake); // every day at 06:30:00
+// DS3231_ALARMx_SPEC takes one of the PER_ defines: PER_MINUTE matches the seconds (alarm 2: fires
+// every minute), PER_HOUR also the minutes, PER_DAY also the hours, PER_WEEK also the day of the
+// week (day 1 to 7), PER_MONTH also the date (day 1 to 31). Fields that are not matched are ignored
+// and should be 0. DS3231_ALARMx_SPEC_RAW takes the mask bits directly (bit 0 to 3 = AxM1 to
+// AxM4 in register order, alarm 2 has no seconds so its bit 0 is A2M2, plus
+// DS3231_ALARM_MATCH_DAY), so every combination the DS3231 supports can be expressed.
+struct DS3231_Alarm1Spec
+{
+  uint8_t reg[4]; // registers 0x07 to 0x0A
+};
+
+struct DS3231_Alarm2Spec
+{
+  uint8_t reg[3]; // registers 0x0B to 0x0D
+};
+
+#define DS3231_ALARM_MATCH_DAY 0x10 // mask bit: the day field is the day of the week (DY/DT = 1), not the date
+#define DS3231_ALARM_CHECK(cond) (sizeof(char[(cond) ? 1 : -1]) - 1) // 0, does not compile if cond is false
+#define DS3231_ALARM_BCD(v) ((((v) / 10) << 4) | ((v) % 10))
+#define DS3231_ALARM_FIELD(ignored, v, max) \
+  ((uint8_t)(((ignored) ? 0x80 : DS3231_ALARM_BCD(v)) + DS3231_ALARM_CHECK((ignored) || ((v) >= 0 && (v) <= (max)))))
+#define DS3231_ALARM_DAY_FIELD(ignored, dy, d) \
+  ((uint8_t)(((ignored) ? 0x80 : (dy) ? (0x40 | (d)) : DS3231_ALARM_BCD(d)) + \
+             DS3231_ALARM_CHECK((ignored) || ((d) >= 1 && (d) <= ((dy) ? 7 : 31)))))
+
+#define DS3231_ALARM1_SPEC_RAW(mask, seconds, minutes, hours, day) \
+  { { (uint8_t)(DS3231_ALARM_FIELD((mask) & 0x01, seconds, 59) + DS3231_ALARM_CHECK((mask) >= 0 && (mask) <= 0x1F)), \
+      DS3231_ALARM_FIELD((mask) & 0x02, minutes, 59), \
+      DS3231_ALARM_FIELD((mask) & 0x04, hours, 23), \
+      DS3231_ALARM_DAY_FIELD((mask) & 0x08, (mask) & DS3231_ALARM_MATCH_DAY, day) } }
+#define DS3231_ALARM1_MASK(period) \
+  (((period) == PER_MINUTE ? 0x0E : (period) == PER_HOUR ? 0x0C : (period) == PER_DAY ? 0x08 : \
+    (period) == PER_WEEK ? DS3231_ALARM_MATCH_DAY : 0x00) + DS3231_ALARM_CHECK((period) >= PER_MINUTE && (period) <= PER_MONTH))
+#define DS3231_ALARM1_SPEC(period, seconds, minutes, hours, day) \
+  DS3231_ALARM1_SPEC_RAW(DS3231_ALARM1_MASK(period), seconds, minutes, hours, day)
+#define DS3231_ALARM1_EVERY_SECOND DS3231_ALARM1_SPEC_RAW(0x0F, 0, 0, 0, 0)
+
+#define DS3231_ALARM2_SPEC_RAW(mask, minutes, hours, day) \
+  { { (uint8_t)(DS3231_ALARM_FIELD((mask) & 0x01, minutes, 59) + DS3231_ALARM_CHECK((mask) >= 0 && (mask) <= 0x17 && !((mask) & 0x08))), \
+      DS3231_ALARM_FIELD((mask) & 0x02, hours, 23), \
+      DS3231_ALARM_DAY_FIELD((mask) & 0x04, (mask) & DS3231_ALARM_MATCH_DAY, day) } }
+#define DS3231_ALARM2_MASK(period) \
+  (((period) == PER_MINUTE ? 0x07 : (period) == PER_HOUR ? 0x06 : (period) == PER_DAY ? 0x04 : \
+    (period) == PER_WEEK ? DS3231_ALARM_MATCH_DAY : 0x00) + DS3231_ALARM_CHECK((period) >= PER_MINUTE && (period) <= PER_MONTH))
+#define DS3231_ALARM2_SPEC(period, minutes, hours, day) \
+  DS3231_ALARM2_SPEC_RAW(DS3231_ALARM2_MASK(period), minutes, hours, day)
+
 // structure for setting the control register
 struct DS3231_Init_Struct
 {
@@ -30,6 +100,21 @@ struct DS3231_Init_Struct
   uint8_t SquareWaveFreq; // this variable controls the frequency of the square wave (that is outputted on pin 3), see defines below for possible parameter values
   uint8_t Alarm1InterruptEnable; // this bit controls whether Alarm 1 will generate an interrupt signal on pin 3 (provided Interrupt is enabled with the SquareWaveOrInterrupt bit), see defines below for possible parameter values
   uint8_t Alarm2InterruptEnable; // this bit controls whether Alarm 2 will generate an interrupt signal on pin 3 (provided Interrupt is enabled with the SquareWaveOrInterrupt bit), see defines below for possible parameter values
+  uint32_t CpuFrequency; // frequency of the system clock in Hz, 0 selects SYSCLOCKFREQ
+  uint32_t BusSpeed; // requested SCL frequency in Hz (at most 400 kHz), 0 selects 100 kHz, see defines below for the standard values
+};
+
+// structure holding a complete date and time, the fields are in the same order as the
+// timekeeping registers (0x00 to 0x06) of the DS3231
+struct DS3231_DateTime
+{
+  uint8_t seconds; // 0 to 59
+  uint8_t minutes; // 0 to 59
+  uint8_t hours; // 0 to 23
+  uint8_t day; // day of the week, 1 to 7 (see defines above, monday = 1)
+  uint8_t day_of_month; // 1 to 31
+  uint8_t month; // 1 to 12
+  uint8_t year; // 0 to 199 (2000 to 2199, the hundreds are kept in the century bit)
 };
 
 // possible parameter values for the EnableOscillator field of the DS3231_Init_Struct
@@ -58,18 +143,78 @@ struct DS3231_Init_Struct
 #define ALARM2_INT_DISABLE 0
 #define ALARM2_INT_ENABLE 0b00000010
 
+// flags returned by DS3231_ServiceInterrupt (bit positions of the status register)
+#define DS3231_FLAG_A1F 0b00000001 // alarm 1 fired
+#define DS3231_FLAG_A2F 0b00000010 // alarm 2 fired
+#define DS3231_FLAG_BSY 0b00000100 // temperature conversion in progress
+#define DS3231_FLAG_OSF 0b10000000 // the oscillator has stopped at some point, the time may be invalid
+
+// standard values for the BusSpeed field of the DS3231_Init_Struct
+#define DS3231_BUS_100KHZ 100000UL // standard mode
+#define DS3231_BUS_400KHZ 400000UL // fast mode
+
+// retry and recovery counters of the bus, see DS3231_GetBusErrors
+struct DS3231_BusErrors
+{
+  uint16_t retries; // number of failed attempts that were repeated
+  uint16_t recoveries; // number of bus recoveries (SCL pulses and stop condition)
+  uint16_t failures; // number of operations that still failed after all retries
+};
+
+// unix time of 2000-01-01 00:00:00, the first second the DS3231 can represent
+#define DS3231_EPOCH_2000 946684800UL
+
 // public function prototypes (for using the DS3231 lib)
 uint8_t DS3231_PutInKnownI2CState(void);
 uint8_t DS3231_Init(struct DS3231_Init_Struct* pStruct);
+uint8_t DS3231_Restore(struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_ClearOscillatorStopFlag(void);
+uint32_t DS3231_GetBusFrequency(void);
+void DS3231_SetRetryPolicy(uint8_t retries, uint16_t backoff_us);
+void DS3231_GetBusErrors(struct DS3231_BusErrors* pErrors);
+void DS3231_ResetBusErrors(void);
+uint32_t DS3231_DateTimeToSeconds(const struct DS3231_DateTime* pDateTime);
+void DS3231_SecondsToDateTime(uint32_t seconds, struct DS3231_DateTime* pDateTime);
+uint32_t DS3231_DateTimeToEpoch(const struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_EpochToDateTime(uint32_t epoch, struct DS3231_DateTime* pDateTime);
 uint8_t DS3231_SetTime(uint8_t seconds, uint8_t minutes, uint8_t hours);
 uint8_t DS3231_ReadTime(uint8_t* seconds, uint8_t* minutes, uint8_t* hours);
 uint8_t DS3231_SetDate(uint8_t day_of_month, uint8_t month, uint8_t year);
 uint8_t DS3231_ReadDate(uint8_t* day_of_month, uint8_t* month, uint8_t* year);
+uint8_t DS3231_SetDateTime(const struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_CheckDateTime(const struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_SetDateTimePrecise(const struct DS3231_DateTime* pDateTime, uint16_t subsec_ms, int16_t* edge_error_ms);
+uint8_t DS3231_ReadDateTime(struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_ReadDateTimeAsync(struct DS3231_DateTime* pDateTime, void (*done)(uint8_t status));
+uint8_t DS3231_SetEpoch(uint32_t epoch);
+uint8_t DS3231_ReadEpoch(uint32_t* epoch);
 uint8_t DS3231_SetAlarm1(uint8_t seconds, uint8_t minutes, uint8_t hours, uint8_t day, uint8_t day_of_month);
+uint8_t DS3231_SetAlarm1Spec(const struct DS3231_Alarm1Spec* pSpec);
+uint8_t DS3231_SetAlarm1Spec_P(const struct DS3231_Alarm1Spec* pSpec);
 uint8_t DS3231_ReadAlarm1Flag(void);
 uint8_t DS3231_ClearAlarm1Flag(void);
 uint8_t DS3231_SetAlarm2(uint8_t minutes, uint8_t hours, uint8_t day, uint8_t day_of_month);
+uint8_t DS3231_SetAlarm2Spec(const struct DS3231_Alarm2Spec* pSpec);
+uint8_t DS3231_SetAlarm2Spec_P(const struct DS3231_Alarm2Spec* pSpec);
 uint8_t DS3231_ReadAlarm2Flag(void);
 uint8_t DS3231_ClearAlarm2Flag(void);
+uint8_t DS3231_ServiceInterrupt(uint8_t* fired_mask);
+uint8_t DS3231_Enable32kHzOutput(uint8_t enable);
+uint8_t DS3231_ModifyControl(uint8_t mask, uint8_t bits);
+void DS3231_InvalidateCache(void);
+uint8_t DS3231_StartTempConversion(void);
+uint8_t DS3231_PollTemp(int16_t* centi_celsius);
+uint8_t DS3231_ReadTempAndStatus(int16_t* centi_celsius, uint8_t* status);
+uint8_t DS3231_ReadAgingOffset(int8_t* offset);
+uint8_t DS3231_SetAgingOffset(int8_t offset);
+uint8_t DS3231_SoftClock_Start(uint16_t resync_period);
+void DS3231_SoftClock_Stop(void);
+void DS3231_SoftClock_Tick(void);
+uint8_t DS3231_SoftClock_Service(void);
+void DS3231_SoftClock_GetDrift(uint16_t* count, int32_t* last_drift);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
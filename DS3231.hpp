@@ -0,0 +1,418 @@
+#ifndef DS3231_LIB_HPP
+#define DS3231_LIB_HPP
+
+// Header-only C++ interface of the DS3231 lib. DS3231<Bus> is a set of static functions on top
+// of a bus backend with the two static functions
+//   static uint8_t read(uint8_t reg, uint8_t* buf, uint8_t len);
+//   static uint8_t write(uint8_t reg, const uint8_t* buf, uint8_t len);
+// returning the codes of DS3231_Bus_Read/DS3231_Bus_Write. Everything is resolved at compile
+// time and inlined, there is no function pointer. On the target use ds3231::AvrBus (the
+// interrupt driven engine of DS3231_Bus.c, with its retry policy), on a host a mock with the
+// same two functions:
+//   typedef DS3231<ds3231::AvrBus> Rtc;
+//   Rtc::setSquareWave<1024>();
+//   Rtc::setAlarm1<ds3231::alarm1::MatchHoursMinutesSeconds>(0, 30, 6, 0);
+// Constant arguments (square wave frequency, alarm masks) are template arguments and are
+// checked with static_assert, an invalid one does not compile.
+//
+// Both interfaces use the same register map, BCD kernels and bus engine. DS3231.c keeps shadow
+// copies of the control register, the EN32kHz bit and the alarms, and a software clock, so with
+// ds3231::AvrBus the functions that write these registers (or read the time) call the C API
+// instead of the bus: the C and the C++ interface can be mixed. With any other backend (see
+// ds3231::UsesCApi) the registers are accessed through the backend. Needs C++11, compiles
+// without warnings with -pedantic.
+
+#include <stdint.h>
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Bcd.h"
+
+namespace ds3231
+{
+  // register map
+  namespace reg
+  {
+    constexpr uint8_t Seconds = 0x00;
+    constexpr uint8_t Minutes = 0x01;
+    constexpr uint8_t Hours = 0x02;
+    constexpr uint8_t Day = 0x03;
+    constexpr uint8_t Date = 0x04;
+    constexpr uint8_t Month = 0x05;
+    constexpr uint8_t Year = 0x06;
+    constexpr uint8_t Alarm1 = 0x07; // seconds, minutes, hours, day/date
+    constexpr uint8_t Alarm2 = 0x0B; // minutes, hours, day/date
+    constexpr uint8_t Control = 0x0E;
+    constexpr uint8_t Status = 0x0F;
+    constexpr uint8_t Aging = 0x10;
+    constexpr uint8_t TempMsb = 0x11;
+    constexpr uint8_t TempLsb = 0x12;
+    constexpr uint8_t Count = 0x13;
+  }
+
+  // bits of the control register
+  namespace ctrl
+  {
+    constexpr uint8_t EOSC = 0x80; // oscillator disabled on battery
+    constexpr uint8_t BBSQW = 0x40; // square wave on battery
+    constexpr uint8_t CONV = 0x20; // start a temperature conversion
+    constexpr uint8_t RS = 0x18; // square wave frequency
+    constexpr uint8_t INTCN = 0x04; // INT/SQW pin is the alarm interrupt
+    constexpr uint8_t A2IE = 0x02;
+    constexpr uint8_t A1IE = 0x01;
+  }
+
+  // bits of the status register
+  namespace status
+  {
+    constexpr uint8_t OSF = 0x80; // oscillator stopped
+    constexpr uint8_t EN32kHz = 0x08;
+    constexpr uint8_t BSY = 0x04; // temperature conversion in progress
+    constexpr uint8_t A2F = 0x02;
+    constexpr uint8_t A1F = 0x01;
+    constexpr uint8_t Flags = OSF | A2F | A1F; // writing a 1 leaves these unchanged
+  }
+
+  // masks of the alarm registers (datasheet table 2): bit 0 to 3 are the AxMy bits of the
+  // registers in address order, bit 4 is DY/DT (match the day of the week, not the date)
+  constexpr uint8_t AlarmMaskDay = 0x10;
+  namespace alarm1
+  {
+    constexpr uint8_t EverySecond = 0x0F;
+    constexpr uint8_t MatchSeconds = 0x0E;
+    constexpr uint8_t MatchMinutesSeconds = 0x0C;
+    constexpr uint8_t MatchHoursMinutesSeconds = 0x08;
+    constexpr uint8_t MatchDate = 0x00; // date, hours, minutes and seconds
+    constexpr uint8_t MatchDay = AlarmMaskDay; // day of the week, hours, minutes and seconds
+
+    constexpr bool Valid(uint8_t mask)
+    {
+      return mask == EverySecond || mask == MatchSeconds || mask == MatchMinutesSeconds ||
+             mask == MatchHoursMinutesSeconds || mask == MatchDate || mask == MatchDay;
+    }
+  }
+  namespace alarm2
+  {
+    constexpr uint8_t EveryMinute = 0x07; // at second 00 of every minute
+    constexpr uint8_t MatchMinutes = 0x06;
+    constexpr uint8_t MatchHoursMinutes = 0x04;
+    constexpr uint8_t MatchDate = 0x00; // date, hours and minutes
+    constexpr uint8_t MatchDay = AlarmMaskDay; // day of the week, hours and minutes
+
+    constexpr bool Valid(uint8_t mask)
+    {
+      return mask == EveryMinute || mask == MatchMinutes || mask == MatchHoursMinutes ||
+             mask == MatchDate || mask == MatchDay;
+    }
+  }
+
+  // RS bits of the control register for a square wave frequency in Hz, 0xFF if not supported
+  constexpr uint8_t SquareWaveBits(uint16_t hz)
+  {
+    return hz == 1 ? 0x00 : hz == 1024 ? 0x08 : hz == 4096 ? 0x10 : hz == 8192 ? 0x18 : 0xFF;
+  }
+
+  // Alarm specifications built at compile time, the C++ form of DS3231_ALARM1_SPEC_RAW and
+  // DS3231_ALARM2_SPEC_RAW (DS3231.h): Mask is any combination of the AxMy bits and
+  // AlarmMaskDay, e.g. one of ds3231::alarm1. Use them in a constant expression
+  //   constexpr DS3231_Alarm1Spec wake = ds3231::alarm1Spec<ds3231::alarm1::MatchHoursMinutesSeconds>(0, 30, 6, 0);
+  // there a field out of range calls invalidAlarmField, which is not constexpr, and does not
+  // compile. Fields the mask ignores are not checked.
+  void invalidAlarmField(); // never defined
+
+  namespace detail
+  {
+    constexpr uint8_t bcd(uint8_t v)
+    {
+      return (uint8_t)(((v / 10) << 4) | (v % 10));
+    }
+
+    constexpr uint8_t field(bool ignored, uint8_t v, uint8_t max)
+    {
+      return ignored ? 0x80 : v <= max ? bcd(v) : (invalidAlarmField(), 0);
+    }
+
+    constexpr uint8_t dayField(bool ignored, bool dy, uint8_t day)
+    {
+      return ignored ? 0x80 : (day < 1 || day > (dy ? 7 : 31)) ? (invalidAlarmField(), 0) : dy ? (uint8_t)(0x40 | day) : bcd(day);
+    }
+  }
+
+  template<uint8_t Mask>
+  constexpr struct DS3231_Alarm1Spec alarm1Spec(uint8_t seconds, uint8_t minutes, uint8_t hours, uint8_t day)
+  {
+    static_assert(Mask <= 0x1F, "alarm 1 mask: bit 0 to 3 are A1M1 to A1M4, bit 4 is AlarmMaskDay");
+    return DS3231_Alarm1Spec{{detail::field(Mask & 0x01, seconds, 59), detail::field(Mask & 0x02, minutes, 59),
+                              detail::field(Mask & 0x04, hours, 23), detail::dayField(Mask & 0x08, Mask & AlarmMaskDay, day)}};
+  }
+
+  template<uint8_t Mask>
+  constexpr struct DS3231_Alarm2Spec alarm2Spec(uint8_t minutes, uint8_t hours, uint8_t day)
+  {
+    static_assert(Mask <= 0x17 && !(Mask & 0x08), "alarm 2 mask: bit 0 to 2 are A2M2 to A2M4, bit 4 is AlarmMaskDay");
+    return DS3231_Alarm2Spec{{detail::field(Mask & 0x01, minutes, 59), detail::field(Mask & 0x02, hours, 23),
+                              detail::dayField(Mask & 0x04, Mask & AlarmMaskDay, day)}};
+  }
+
+  static_assert(reg::TempLsb + 1 == reg::Count && reg::Count == REGISTER_COUNT, "register map does not match DS3231_Bus.h");
+  static_assert(reg::Alarm2 == reg::Alarm1 + 4 && reg::Control == reg::Alarm2 + 3, "alarm registers are not contiguous");
+  static_assert(sizeof(struct DS3231_DateTime) == reg::Year - reg::Seconds + 1, "DS3231_DateTime must mirror the timekeeping registers");
+  static_assert(sizeof(struct DS3231_Alarm1Spec) == reg::Alarm2 - reg::Alarm1 && sizeof(struct DS3231_Alarm2Spec) == reg::Control - reg::Alarm2, "alarm specs must mirror the alarm registers");
+
+  // bus backend on the DS3231_Bus.c engine of the ATmega328
+  struct AvrBus
+  {
+    static uint8_t read(uint8_t reg, uint8_t* buf, uint8_t len) { return DS3231_Bus_Read(reg, buf, len); }
+    static uint8_t write(uint8_t reg, const uint8_t* buf, uint8_t len) { return DS3231_Bus_Write(reg, buf, len); }
+  };
+
+  // true for a backend that talks to the DS3231 of the C API, DS3231<Bus> then calls DS3231.c
+  // for the registers it keeps shadow copies of
+  template<class Bus>
+  struct UsesCApi
+  {
+    static constexpr bool value = false;
+  };
+
+  template<>
+  struct UsesCApi<AvrBus>
+  {
+    static constexpr bool value = true;
+  };
+
+  namespace detail
+  {
+    template<bool CApi>
+    struct Path {}; // selects the implementation of a DS3231<Bus> function
+  }
+}
+
+template<class Bus>
+class DS3231
+{
+public:
+  // reads registers 0x00 to 0x06 in one burst, same codes as DS3231_ReadDateTime
+  static uint8_t readDateTime(struct DS3231_DateTime& dt)
+  {
+    return readDateTime(dt, Path());
+  }
+
+  // writes registers 0x00 to 0x06 in one burst, same codes as DS3231_SetDateTime
+  static uint8_t setDateTime(const struct DS3231_DateTime& dt)
+  {
+    return setDateTime(dt, Path());
+  }
+
+  // programs alarm 1 in one burst, Mask is one of ds3231::alarm1. Fields the mask ignores
+  // are not checked. day is the day of the week (1 to 7) for MatchDay, else the date (1 to 31)
+  // Returns 0 (or a bus error code), 2 if a matched field is out of range
+  template<uint8_t Mask>
+  static uint8_t setAlarm1(uint8_t seconds, uint8_t minutes, uint8_t hours, uint8_t day)
+  {
+    static_assert(ds3231::alarm1::Valid(Mask), "invalid alarm 1 mask, use one of ds3231::alarm1");
+    if(!(Mask & 0x01) && seconds > 59)
+      return 2;
+    if(!(Mask & 0x02) && minutes > 59)
+      return 2;
+    if(!(Mask & 0x04) && hours > 23)
+      return 2;
+    if(!(Mask & 0x08) && !validDay<Mask>(day))
+      return 2;
+
+    struct DS3231_Alarm1Spec spec;
+    spec.reg[0] = field<Mask & 0x01>(seconds);
+    spec.reg[1] = field<Mask & 0x02>(minutes);
+    spec.reg[2] = field<Mask & 0x04>(hours);
+    spec.reg[3] = dayField<Mask, 0x08>(day);
+    return setAlarm1(spec);
+  }
+
+  // programs alarm 2 in one burst, Mask is one of ds3231::alarm2, see setAlarm1
+  template<uint8_t Mask>
+  static uint8_t setAlarm2(uint8_t minutes, uint8_t hours, uint8_t day)
+  {
+    static_assert(ds3231::alarm2::Valid(Mask), "invalid alarm 2 mask, use one of ds3231::alarm2");
+    if(!(Mask & 0x01) && minutes > 59)
+      return 2;
+    if(!(Mask & 0x02) && hours > 23)
+      return 2;
+    if(!(Mask & 0x04) && !validDay<Mask>(day))
+      return 2;
+
+    struct DS3231_Alarm2Spec spec;
+    spec.reg[0] = field<Mask & 0x01>(minutes);
+    spec.reg[1] = field<Mask & 0x02>(hours);
+    spec.reg[2] = dayField<Mask, 0x04>(day);
+    return setAlarm2(spec);
+  }
+
+  // programs alarm 1 or 2 from a specification (ds3231::alarm1Spec, DS3231_ALARM1_SPEC, ...) in
+  // one burst, nothing is encoded or checked at runtime
+  static uint8_t setAlarm1(const struct DS3231_Alarm1Spec& spec)
+  {
+    return setAlarm1(spec, Path());
+  }
+
+  static uint8_t setAlarm2(const struct DS3231_Alarm2Spec& spec)
+  {
+    return setAlarm2(spec, Path());
+  }
+
+  // changes the bits of the control register selected by mask, see DS3231_ModifyControl. CONV
+  // is never written back, it is cleared by the DS3231 when a conversion has finished
+  static uint8_t modifyControl(uint8_t mask, uint8_t bits)
+  {
+    return modifyControl(mask, bits, Path());
+  }
+
+  // outputs a square wave of Hz (1, 1024, 4096 or 8192) on the INT/SQW pin
+  template<uint16_t Hz>
+  static uint8_t setSquareWave()
+  {
+    static_assert(ds3231::SquareWaveBits(Hz) != 0xFF, "the DS3231 only outputs 1, 1024, 4096 or 8192 Hz");
+    return modifyControl(ds3231::ctrl::RS | ds3231::ctrl::INTCN, ds3231::SquareWaveBits(Hz));
+  }
+
+  // reads the status register
+  static uint8_t readStatus(uint8_t& value)
+  {
+    return Bus::read(ds3231::reg::Status, &value, 1);
+  }
+
+  // clears the flags (ds3231::status::A1F, A2F and/or OSF) without touching the others
+  static uint8_t clearFlags(uint8_t flags)
+  {
+    return clearFlags(flags, Path());
+  }
+
+  // enables or disables the 32kHz output, the flags are left unchanged
+  static uint8_t enable32kHzOutput(bool enable)
+  {
+    return enable32kHzOutput(enable, Path());
+  }
+
+private:
+  typedef ds3231::detail::Path<ds3231::UsesCApi<Bus>::value> Path;
+  typedef ds3231::detail::Path<true> CApi; // the function of DS3231.c keeps its shadow copies
+  typedef ds3231::detail::Path<false> Direct; // registers accessed through Bus
+
+  static uint8_t readDateTime(struct DS3231_DateTime& dt, CApi)
+  {
+    return DS3231_ReadDateTime(&dt);
+  }
+
+  static uint8_t readDateTime(struct DS3231_DateTime& dt, Direct)
+  {
+    uint8_t raw[7];
+    uint8_t ret = Bus::read(ds3231::reg::Seconds, raw, 7);
+    if(ret == 0)
+      DS3231_DecodeBCDBlock(raw, reinterpret_cast<uint8_t*>(&dt));
+    return ret;
+  }
+
+  static uint8_t setDateTime(const struct DS3231_DateTime& dt, CApi)
+  {
+    return DS3231_SetDateTime(&dt);
+  }
+
+  static uint8_t setDateTime(const struct DS3231_DateTime& dt, Direct)
+  {
+    uint8_t ret = DS3231_CheckDateTime(&dt);
+    if(ret != 0)
+      return ret;
+
+    uint8_t raw[7];
+    DS3231_EncodeBCDBlock(reinterpret_cast<const uint8_t*>(&dt), raw);
+    return Bus::write(ds3231::reg::Seconds, raw, 7);
+  }
+
+  static uint8_t setAlarm1(const struct DS3231_Alarm1Spec& spec, CApi)
+  {
+    return DS3231_SetAlarm1Spec(&spec);
+  }
+
+  static uint8_t setAlarm1(const struct DS3231_Alarm1Spec& spec, Direct)
+  {
+    return Bus::write(ds3231::reg::Alarm1, spec.reg, 4);
+  }
+
+  static uint8_t setAlarm2(const struct DS3231_Alarm2Spec& spec, CApi)
+  {
+    return DS3231_SetAlarm2Spec(&spec);
+  }
+
+  static uint8_t setAlarm2(const struct DS3231_Alarm2Spec& spec, Direct)
+  {
+    return Bus::write(ds3231::reg::Alarm2, spec.reg, 3);
+  }
+
+  static uint8_t modifyControl(uint8_t mask, uint8_t bits, CApi)
+  {
+    return DS3231_ModifyControl(mask, bits);
+  }
+
+  static uint8_t modifyControl(uint8_t mask, uint8_t bits, Direct)
+  {
+    uint8_t ctrl;
+    uint8_t ret = Bus::read(ds3231::reg::Control, &ctrl, 1);
+    if(ret != 0)
+      return ret;
+    ctrl = (uint8_t)((ctrl & ~mask & ~ds3231::ctrl::CONV) | (bits & mask));
+    return Bus::write(ds3231::reg::Control, &ctrl, 1);
+  }
+
+  // one write per flag, DS3231.c writes the status register from its EN32kHz shadow
+  static uint8_t clearFlags(uint8_t flags, CApi)
+  {
+    uint8_t ret = 0;
+    if(flags & ds3231::status::OSF)
+      ret = DS3231_ClearOscillatorStopFlag();
+    if(ret == 0 && (flags & ds3231::status::A1F))
+      ret = DS3231_ClearAlarm1Flag();
+    if(ret == 0 && (flags & ds3231::status::A2F))
+      ret = DS3231_ClearAlarm2Flag();
+    return ret;
+  }
+
+  static uint8_t clearFlags(uint8_t flags, Direct)
+  {
+    uint8_t value;
+    uint8_t ret = readStatus(value);
+    if(ret != 0)
+      return ret;
+    value = (uint8_t)((ds3231::status::Flags & ~flags) | (value & ds3231::status::EN32kHz));
+    return Bus::write(ds3231::reg::Status, &value, 1);
+  }
+
+  static uint8_t enable32kHzOutput(bool enable, CApi)
+  {
+    return DS3231_Enable32kHzOutput(enable ? 1 : 0);
+  }
+
+  static uint8_t enable32kHzOutput(bool enable, Direct)
+  {
+    uint8_t value = ds3231::status::Flags | (enable ? ds3231::status::EN32kHz : 0);
+    return Bus::write(ds3231::reg::Status, &value, 1);
+  }
+
+  // alarm register value of a matched (BCD) or ignored (AxMy bit set) field
+  template<uint8_t Ignored>
+  static uint8_t field(uint8_t value)
+  {
+    return Ignored ? 0x80 : DS3231_EncodeBCD(value);
+  }
+
+  // alarm register value of the day/date field, Bit is the AxM4 bit of the mask
+  template<uint8_t Mask, uint8_t Bit>
+  static uint8_t dayField(uint8_t day)
+  {
+    return (Mask & Bit) ? 0x80 : (Mask & ds3231::AlarmMaskDay) ? (uint8_t)(0x40 | day) : DS3231_EncodeBCD(day);
+  }
+
+  template<uint8_t Mask>
+  static bool validDay(uint8_t day)
+  {
+    return (Mask & ds3231::AlarmMaskDay) ? (day >= 1 && day <= 7) : (day >= 1 && day <= 31);
+  }
+};
+
+#endif
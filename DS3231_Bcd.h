@@ -0,0 +1,76 @@
+#ifndef DS3231_BCD_HEADER
+#define DS3231_BCD_HEADER
+
+// BCD conversion kernels shared by the modules of the DS3231 lib. The ATmega328 has no
+// divider, (x%10) | ((x/10)<<4) costs a __udivmodqi4 call with -Os. These kernels use the
+// hardware multiplier instead:
+//  - DS3231_EncodeBCD: tens = (x*103)>>10 is exact for x = 0 to 99, bcd = x + 6*tens
+//    (a mul, two shifts and a second mul)
+//  - DS3231_DecodeBCD: x = bcd - 6*(bcd>>4) (a swap/and and a mul)
+// Estimated from the instruction counts, not measured: about 10 and 6 cycles, against 60 to
+// 70 cycles for the division. host/DS3231_BcdTest.c checks both exhaustively against the
+// division based arithmetic (all values 0 to 99, all valid BCD values, the block functions
+// for every year 0 to 199).
+
+#include <stdint.h>
+
+// masks of the valid bits of the timekeeping registers 0x00 to 0x06 (seconds, minutes, hours
+// in 24 hour mode, day, date, month without century bit, year)
+#define DS3231_BCD_MASK_SECONDS 0x7F
+#define DS3231_BCD_MASK_MINUTES 0x7F
+#define DS3231_BCD_MASK_HOURS   0x3F
+#define DS3231_BCD_MASK_DAY     0x07
+#define DS3231_BCD_MASK_DATE    0x3F
+#define DS3231_BCD_MASK_MONTH   0x1F
+#define DS3231_BCD_MASK_YEAR    0xFF
+
+// century bit of the month register, toggled by the DS3231 when the year rolls over from
+// 99 to 00. The lib uses it as the hundreds of the year: year 0 to 199 = 2000 to 2199
+#define DS3231_BCD_CENTURY      0x80
+
+// converts a binary value (0 to 99) to BCD
+static inline uint8_t DS3231_EncodeBCD(uint8_t value)
+{
+  uint8_t tens = (uint8_t)(((uint16_t)value * 103) >> 10);
+  return value + (uint8_t)(tens * 6);
+}
+
+// converts a BCD value (00 to 99, flag bits already masked off) to binary
+static inline uint8_t DS3231_DecodeBCD(uint8_t bcd)
+{
+  return bcd - (uint8_t)((bcd >> 4) * 6);
+}
+
+// decodes the 7 registers of the timekeeping block (0x00 to 0x06) at once, the century bit
+// is taken into the year (0 to 199). Every input byte is read before the output byte with
+// the same index is written, so raw and out may be the same
+static inline void DS3231_DecodeBCDBlock(const uint8_t* raw, uint8_t* out)
+{
+  uint8_t century = raw[5] & DS3231_BCD_CENTURY;
+  out[0] = DS3231_DecodeBCD(raw[0] & DS3231_BCD_MASK_SECONDS);
+  out[1] = DS3231_DecodeBCD(raw[1] & DS3231_BCD_MASK_MINUTES);
+  out[2] = DS3231_DecodeBCD(raw[2] & DS3231_BCD_MASK_HOURS);
+  out[3] = raw[3] & DS3231_BCD_MASK_DAY;
+  out[4] = DS3231_DecodeBCD(raw[4] & DS3231_BCD_MASK_DATE);
+  out[5] = DS3231_DecodeBCD(raw[5] & DS3231_BCD_MASK_MONTH);
+  out[6] = DS3231_DecodeBCD(raw[6] & DS3231_BCD_MASK_YEAR) + (century ? 100 : 0);
+}
+
+// encodes 7 binary values (seconds, minutes, hours, day, date, month, year 0 to 199, all
+// already validated) into the register image of the timekeeping block, years 100 to 199 set
+// the century bit. in and raw may be the same
+static inline void DS3231_EncodeBCDBlock(const uint8_t* in, uint8_t* raw)
+{
+  uint8_t year = in[6];
+  uint8_t i;
+  for(i = 0; i < 6; i++)
+    raw[i] = DS3231_EncodeBCD(in[i]); // the day (1 to 7) is the same in BCD
+  if(year >= 100)
+  {
+    year -= 100;
+    raw[5] |= DS3231_BCD_CENTURY;
+  }
+  raw[6] = DS3231_EncodeBCD(year);
+}
+
+#endif
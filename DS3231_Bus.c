@@ -0,0 +1,789 @@
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Trace.h"
+#include "DS3231_Stats.h"
+#include "Gpio.h"
+#include "Timer.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/twi.h>
+
+#define TWI_POLL_CYCLES 16 // CPU cycles of one iteration of the polling loops (estimate for avr-gcc -Os)
+#define TWI_TIMEOUT_LOOPS(cpu_freq) ((cpu_freq) / 1000000UL * DS3231_BUS_TIMEOUT_US / TWI_POLL_CYCLES)
+
+// open drain access to SDA (PC4) and SCL (PC5) for the bus recovery: a line is only ever driven
+// low, released it is pulled up
+#define SDA_RELEASE() GPIO_PinMode(GPIOC, GPIO_PIN_4, GPIO_INPUT, GPIO_PULLUP)
+#define SDA_LOW()     GPIO_PinMode(GPIOC, GPIO_PIN_4, GPIO_OUTPUT, GPIO_NOPULLUP)
+#define SDA_READ()    GPIO_ReadPin(GPIOC, GPIO_PIN_4)
+#define SCL_RELEASE() GPIO_PinMode(GPIOC, GPIO_PIN_5, GPIO_INPUT, GPIO_PULLUP)
+#define SCL_LOW()     GPIO_PinMode(GPIOC, GPIO_PIN_5, GPIO_OUTPUT, GPIO_NOPULLUP)
+#define SCL_READ()    GPIO_ReadPin(GPIOC, GPIO_PIN_5)
+
+#ifdef DS3231_BUS_ACCOUNTING
+static struct DS3231_BusCost bus_cost; // bus usage since the last call of DS3231_Bus_ResetCost
+#define BUS_COUNT(field) (bus_cost.field++)
+#else
+#define BUS_COUNT(field) ((void)0)
+#endif
+
+#ifdef DS3231_STATS
+static uint8_t op_bytes; // bytes moved by the active operation
+#define STATS_TAG(op) ((op)->fn = DS3231_Stats_Current())
+#define STATS_BYTE() (op_bytes++)
+#define STATS_OP_DONE(op, status) do { DS3231_STATS_TRANSACTION((op)->fn, op_bytes, (status)); op_bytes = 0; } while(0)
+#else
+#define STATS_TAG(op) ((void)0)
+#define STATS_BYTE() ((void)0)
+#define STATS_OP_DONE(op, status) ((void)0)
+#endif
+
+// states of the transaction engine, each state names the action that has just been completed
+#define ST_IDLE      0
+#define ST_START     1 // start condition sent
+#define ST_SLA_W     2 // address + write sent
+#define ST_REG       3 // register pointer sent
+#define ST_TX        4 // data byte sent
+#define ST_REP_START 5 // repeated start condition sent
+#define ST_SLA_R     6 // address + read sent
+#define ST_RX        7 // data byte received
+
+#define OP_READ 0x01 // flag of struct BusOp: the operation reads registers
+
+// a queued DS3231 bus operation
+struct BusOp
+{
+  uint8_t flags; // OP_READ or 0 for a write
+  uint8_t addr; // I2C address of the device (write form, bit 0 = 0)
+  uint8_t reg; // first register (a write of 0 registers only sends this byte, e.g. a command for a mux)
+  uint8_t len; // number of registers
+  uint8_t* buf; // destination of a read
+  uint8_t data[DS3231_BUS_MAX_WRITE]; // copy of the data of a write
+  void (*post)(uint8_t* buf); // called with buf after a succesful read (e.g. for decoding), may be 0
+  void (*done)(uint8_t status); // called when the operation has finished, may be 0
+#ifdef DS3231_STATS
+  uint8_t fn; // function that queued the operation (DS3231_FN_...)
+#endif
+};
+
+static struct BusOp queue[DS3231_BUS_QUEUE_SIZE]; // pending operations, queue[q_head] is the active one
+static volatile uint8_t q_head = 0;
+static volatile uint8_t q_count = 0;
+static volatile uint8_t state = ST_IDLE;
+static volatile uint8_t progress = 0; // incremented on every completed bus action, used by the timeout detection
+static uint8_t idx; // index of the next data byte of the active operation
+
+static uint32_t scl_freq = 0; // achieved SCL frequency, set by DS3231_Bus_Init
+
+static volatile uint8_t sync_done; // set by DS3231_Bus_SyncDone
+static volatile uint8_t sync_status; // status stored by DS3231_Bus_SyncDone
+
+static uint8_t retry_count = DS3231_BUS_RETRIES; // retries of a failed blocking read or write
+static uint16_t retry_backoff_us = DS3231_BUS_BACKOFF_US; // wait before the first retry, doubled on every further retry
+static struct DS3231_BusErrors bus_errors; // retry and recovery counters since the last DS3231_Bus_ResetErrors
+static uint16_t twi_timeout = TWI_TIMEOUT_LOOPS(SYSCLOCKFREQ); // polling iterations without bus progress after which a transfer is considered timed out
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Init
+// Description: This function initializes the TWI hardware that is used to communicate
+//              with the DS3231. SCL = cpu_freq / (16 + 2 * TWBR * prescaler), the smallest
+//              prescaler (1, 4, 16 or 64) is chosen for which TWBR fits in 8 bits and TWBR is
+//              rounded up, so the achieved SCL frequency never exceeds the requested one.
+//              The internal pull-ups of SDA and SCL are enabled. DS3231_BUS_TIMEOUT_US is
+//              converted into polling iterations at cpu_freq (about TWI_POLL_CYCLES each, so
+//              the timeout is approximate).
+// Arguments:
+//  - uint32_t cpu_freq: frequency of the system clock in Hz
+//  - uint32_t bus_speed: requested SCL frequency in Hz (at most 400 kHz, the DS3231 maximum)
+//
+// Returns:
+//  - 0: if the TWI hardware was initialized
+//  - 2: if the bus speed can not be achieved at the given CPU frequency (TWI untouched)
+uint8_t DS3231_Bus_Init(uint32_t cpu_freq, uint32_t bus_speed)
+{
+  uint8_t ps;
+  uint32_t twbr, timeout;
+
+  if(bus_speed == 0 || bus_speed > DS3231_BUS_400KHZ || cpu_freq < 16*bus_speed)
+  {
+    DS3231_TRACE_EVENT(DS3231_EV_BUS_INIT, 0, 2);
+    return 2; // faster than the DS3231 or than the TWI hardware can clock
+  }
+
+  for(ps = 0; ps < 4; ps++)
+  {
+    uint32_t div = 2UL << (2*ps); // 2 * prescaler
+    twbr = (cpu_freq/bus_speed - 16 + div - 1) / div; // rounded up
+    if(cpu_freq/(16 + twbr*div) > bus_speed) // cpu_freq/bus_speed was truncated
+      twbr++;
+    if(twbr <= 255)
+      break;
+  }
+  if(ps == 4)
+  {
+    DS3231_TRACE_EVENT(DS3231_EV_BUS_INIT, 0, 2);
+    return 2; // slower than the TWI hardware can clock
+  }
+
+  GPIO_PinMode(GPIOC, GPIO_PIN_4, GPIO_INPUT, GPIO_PULLUP); // SDA
+  GPIO_PinMode(GPIOC, GPIO_PIN_5, GPIO_INPUT, GPIO_PULLUP); // SCL
+  TWSR = ps; // TWPS1:0
+  TWBR = (uint8_t)twbr;
+  TWCR = (1<<TWEN);
+  scl_freq = cpu_freq / (16 + twbr*(2UL << (2*ps)));
+  timeout = TWI_TIMEOUT_LOOPS(cpu_freq);
+  twi_timeout = (timeout > 0xFFFF) ? 0xFFFF : (timeout < 1) ? 1 : (uint16_t)timeout;
+  DS3231_TRACE_EVENT(DS3231_EV_BUS_INIT, (uint8_t)twbr, 0);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_GetFrequency
+// Description: This function returns the SCL frequency achieved by DS3231_Bus_Init.
+// Arguments: none
+//
+// Returns: the SCL frequency in Hz, 0 if the bus has not been initialized
+uint32_t DS3231_Bus_GetFrequency(void)
+{
+  return scl_freq;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_TWI_Action
+// Description: This function starts the next action of the TWI hardware, the completion
+//              is signalled by the TWI interrupt.
+// Arguments:
+//  - uint8_t twcr: TWSTA for a (repeated) start condition, TWEA to ack a received byte,
+//                  0 for sending TWDR or receiving a byte that will be nacked
+//
+// Returns: nothing
+static void DS3231_TWI_Action(uint8_t twcr)
+{
+  if(twcr & (1<<TWSTA))
+    BUS_COUNT(starts); // (repeated) start condition
+  else
+  {
+    BUS_COUNT(bytes); // every other action moves one byte (address or data) over the bus
+    STATS_BYTE();
+  }
+  TWCR = twcr | (1<<TWINT) | (1<<TWEN) | (1<<TWIE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Finish
+// Description: This function ends the active operation with a stop condition, reports
+//              the status to the callbacks of the operation and starts the next queued
+//              operation (the stop and the next start are requested together).
+// Arguments:
+//  - uint8_t status: 0 if the operation succeeded, 1 for a timeout (or bus error), else the
+//                    unexpected TWI status code
+//
+// Returns: nothing
+static void DS3231_Bus_Finish(uint8_t status)
+{
+  struct BusOp* op = &queue[q_head];
+
+  BUS_COUNT(stops);
+  if(q_count > 1)
+  {
+    BUS_COUNT(starts);
+    TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWSTA) | (1<<TWEN) | (1<<TWIE); // stop followed by a start for the next operation
+    state = ST_START;
+  }
+  else
+  {
+    TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
+    state = ST_IDLE;
+  }
+
+  DS3231_TRACE_EVENT((op->flags & OP_READ) ? DS3231_EV_READ : DS3231_EV_WRITE, op->reg, status);
+  STATS_OP_DONE(op, status);
+  if(status == 0 && (op->flags & OP_READ) && op->post != 0)
+    op->post(op->buf);
+  void (*done)(uint8_t) = op->done;
+
+  q_head = (q_head + 1) % DS3231_BUS_QUEUE_SIZE;
+  q_count--;
+  idx = 0;
+
+  if(done != 0)
+    done(status);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Step
+// Description: This function advances the transaction engine after the TWI hardware has
+//              completed an action (TWINT set). It is called from the TWI interrupt, or by
+//              the blocking functions when interrupts are disabled.
+// Arguments: none
+//
+// Returns: nothing
+static void DS3231_Bus_Step(void)
+{
+  struct BusOp* op = &queue[q_head];
+  uint8_t status = TW_STATUS;
+
+  progress++;
+  switch(state)
+  {
+    case ST_START:
+      if(status != TW_START)
+        break;
+      TWDR = op->addr | TW_WRITE;
+      state = ST_SLA_W;
+      DS3231_TWI_Action(0);
+      return;
+
+    case ST_SLA_W:
+      if(status != TW_MT_SLA_ACK)
+        break;
+      TWDR = op->reg; // set the register pointer of the DS3231
+      state = ST_REG;
+      DS3231_TWI_Action(0);
+      return;
+
+    case ST_REG:
+    case ST_TX:
+      if(status != TW_MT_DATA_ACK)
+        break;
+      if(op->flags & OP_READ)
+      {
+        state = ST_REP_START;
+        DS3231_TWI_Action(1<<TWSTA);
+      }
+      else if(idx < op->len)
+      {
+        TWDR = op->data[idx++];
+        state = ST_TX;
+        DS3231_TWI_Action(0);
+      }
+      else
+        DS3231_Bus_Finish(0);
+      return;
+
+    case ST_REP_START:
+      if(status != TW_REP_START)
+        break;
+      TWDR = op->addr | TW_READ;
+      state = ST_SLA_R;
+      DS3231_TWI_Action(0);
+      return;
+
+    case ST_SLA_R:
+    case ST_RX:
+      if(state == ST_RX)
+      {
+        if(status != TW_MR_DATA_ACK && status != TW_MR_DATA_NACK)
+          break;
+        op->buf[idx++] = TWDR;
+      }
+      else if(status != TW_MR_SLA_ACK)
+        break;
+
+      if(idx < op->len)
+      {
+        state = ST_RX;
+        DS3231_TWI_Action((idx < op->len - 1) ? (1<<TWEA) : 0); // ack all bytes except the last one
+      }
+      else
+        DS3231_Bus_Finish(0);
+      return;
+
+    default: // TWINT while idle, should not happen
+      TWCR = (1<<TWINT) | (1<<TWEN);
+      return;
+  }
+
+  DS3231_Bus_Finish((status == TW_BUS_ERROR) ? 1 : status); // a bus error has status code 0, report it as a timeout so it can not be mistaken for success
+}
+
+ISR(TWI_vect)
+{
+  DS3231_Bus_Step();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Submit
+// Description: This function appends an operation to the queue and starts it when the
+//              bus is idle.
+// Arguments:
+//  - uint8_t flags: OP_READ for a read, 0 for a write
+//  - uint8_t addr: I2C address of the device (write form, DS3231_I2C_ADDRESS for the DS3231)
+//  - uint8_t reg: first register
+//  - uint8_t* buf: destination of a read / data of a write (copied)
+//  - uint8_t len: number of registers (at least 1 for a read)
+//  - void (*post)(uint8_t* buf): called after a succesful read, may be 0
+//  - void (*done)(uint8_t status): called when the operation has finished, may be 0
+//
+// Returns:
+//  - 0: if the operation was queued
+//  - 2: if the queue is full or len is invalid
+static uint8_t DS3231_Bus_Submit(uint8_t flags, uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len, void (*post)(uint8_t*), void (*done)(uint8_t))
+{
+  uint8_t i, ret = 2;
+
+  if((flags & OP_READ) ? (len == 0) : (len > DS3231_BUS_MAX_WRITE))
+    return 2;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if(q_count < DS3231_BUS_QUEUE_SIZE)
+    {
+      struct BusOp* op = &queue[(q_head + q_count) % DS3231_BUS_QUEUE_SIZE];
+      op->flags = flags;
+      op->addr = addr;
+      op->reg = reg;
+      op->len = len;
+      op->buf = buf;
+      op->post = post;
+      op->done = done;
+      STATS_TAG(op);
+      if(!(flags & OP_READ))
+      {
+        for(i = 0; i < len; i++)
+          op->data[i] = buf[i];
+      }
+
+      if(q_count++ == 0) // bus idle, start the operation
+      {
+        uint16_t cnt = 0;
+        while((TWCR & (1<<TWSTO)) && (++cnt < twi_timeout)) // let the stop of the previous operation finish
+          ;
+        idx = 0;
+        state = ST_START;
+        DS3231_TWI_Action(1<<TWSTA);
+      }
+      ret = 0;
+    }
+  }
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_ReadAsync
+// Description: This function queues a burst read of consecutive registers. The function
+//              returns immediately, the transfer is driven by the TWI interrupt.
+// Arguments:
+//  - uint8_t reg: address of the first register to read
+//  - uint8_t* buf: buffer that receives the register values, must stay valid until done
+//                  has been called
+//  - uint8_t len: number of registers to read (at least 1)
+//  - void (*post)(uint8_t* buf): called (from the interrupt) with buf after a succesful
+//                                read, before done, may be 0
+//  - void (*done)(uint8_t status): called (from the interrupt) when the read has finished
+//                                  with the same codes as DS3231_Bus_Read, may be 0
+//
+// Returns:
+//  - 0: if the read was queued
+//  - 2: if the queue is full
+uint8_t DS3231_Bus_ReadAsync(uint8_t reg, uint8_t* buf, uint8_t len, void (*post)(uint8_t* buf), void (*done)(uint8_t status))
+{
+  return DS3231_Bus_Submit(OP_READ, DS3231_I2C_ADDRESS, reg, buf, len, post, done);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_WriteAsync
+// Description: This function queues a burst write of consecutive registers. The data is
+//              copied, buf may be reused as soon as the function returns.
+// Arguments:
+//  - uint8_t reg: address of the first register to write
+//  - const uint8_t* buf: the values that will be written
+//  - uint8_t len: number of registers to write (1 to DS3231_BUS_MAX_WRITE)
+//  - void (*done)(uint8_t status): called (from the interrupt) when the write has finished
+//                                  with the same codes as DS3231_Bus_Write, may be 0
+//
+// Returns:
+//  - 0: if the write was queued
+//  - 2: if the queue is full or len is too large
+uint8_t DS3231_Bus_WriteAsync(uint8_t reg, const uint8_t* buf, uint8_t len, void (*done)(uint8_t status))
+{
+  return DS3231_Bus_Submit(0, DS3231_I2C_ADDRESS, reg, (uint8_t*)buf, len, 0, done);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Abort
+// Description: This function aborts the active operation (the one that makes no progress)
+//              with a stop condition, its done callback is called with status 1 (timeout).
+//              The other queued operations stay queued, the next one starts after the stop.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Bus_Abort(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    DS3231_TRACE_EVENT(DS3231_EV_ABORT, 0, (q_count != 0));
+    if(q_count != 0)
+      DS3231_Bus_Finish(1);
+    else
+    {
+      BUS_COUNT(stops);
+      TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
+      state = ST_IDLE;
+      idx = 0;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Busy
+// Description: This function tells whether operations are queued or in progress.
+// Arguments: none
+//
+// Returns:
+//  - 0: if the bus is idle
+//  - 1: if operations are pending
+uint8_t DS3231_Bus_Busy(void)
+{
+  return q_count != 0;
+}
+
+static void DS3231_Bus_SyncDone(uint8_t status)
+{
+  sync_status = status;
+  sync_done = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Wait
+// Description: This function queues an operation and waits until it has finished. While
+//              interrupts are disabled the engine is driven by polling TWINT. When the bus
+//              makes no progress for DS3231_BUS_TIMEOUT_US the active operation is aborted,
+//              which may be an earlier queued one, the wait then goes on for this operation.
+// Arguments: see DS3231_Bus_Submit
+//
+// Returns:
+//  - 0: if the operation succeeded
+//  - 1: if a timeout error occured
+//  - else: other codes represent specific TWI status errors
+static uint8_t DS3231_Bus_Wait(uint8_t flags, uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len)
+{
+  uint16_t cnt = 0;
+  uint8_t last = progress;
+
+  if((flags & OP_READ) ? (len == 0) : (len > DS3231_BUS_MAX_WRITE))
+    return 2;
+
+  sync_done = 0;
+  while(DS3231_Bus_Submit(flags, addr, reg, buf, len, 0, DS3231_Bus_SyncDone) != 0) // queue full, wait for a free slot
+  {
+    if(!(SREG & (1<<SREG_I)) && (TWCR & (1<<TWINT)))
+      DS3231_Bus_Step();
+    if(progress != last)
+    {
+      last = progress;
+      cnt = 0;
+    }
+    else if(++cnt >= twi_timeout)
+    {
+      DS3231_Bus_Abort(); // frees a slot
+      cnt = 0;
+    }
+  }
+
+  cnt = 0;
+  while(!sync_done)
+  {
+    if(!(SREG & (1<<SREG_I)) && (TWCR & (1<<TWINT)))
+      DS3231_Bus_Step();
+    if(progress != last)
+    {
+      last = progress;
+      cnt = 0;
+    }
+    else if(++cnt >= twi_timeout)
+    {
+      DS3231_Bus_Abort(); // calls DS3231_Bus_SyncDone with status 1 when this operation is the active one
+      cnt = 0;
+    }
+  }
+  return sync_status;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Transfer
+// Description: This function runs a blocking operation with the retry policy set by
+//              DS3231_Bus_SetRetryPolicy. A failed attempt is repeated after the backoff time,
+//              which doubles on every retry. After a timeout or bus error the bus is recovered
+//              first (DS3231_Bus_Recover), a NACK (e.g. a glitch on the address) only waits.
+// Arguments: see DS3231_Bus_Submit
+//
+// Returns: the result of the last attempt, see DS3231_Bus_Wait
+static uint8_t DS3231_Bus_Transfer(uint8_t flags, uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len)
+{
+  uint16_t backoff = retry_backoff_us;
+  uint8_t attempt = 0;
+  uint8_t ret;
+
+  while((ret = DS3231_Bus_Wait(flags, addr, reg, buf, len)) != 0 && ret != 2) // 2: invalid length, a retry can not help
+  {
+    if(attempt++ >= retry_count)
+    {
+      bus_errors.failures++;
+      break;
+    }
+    bus_errors.retries++;
+    DS3231_STATS_RETRY();
+    DS3231_TRACE_EVENT(DS3231_EV_RETRY, reg, ret);
+    if(ret == 1)
+      DS3231_Bus_Recover();
+    if(backoff != 0)
+      Timer0_Delay_us(backoff);
+    if(backoff < 0x8000)
+      backoff <<= 1;
+  }
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Read
+// Description: This function reads a block of consecutive registers from the DS3231 in one
+//              I2C transaction (START, address, register pointer, repeated START, burst read,
+//              STOP) and waits for the result. The DS3231 auto-increments its register
+//              pointer after every byte, so all bytes come from the same snapshot of the
+//              user buffers. Failed reads are retried (see DS3231_Bus_SetRetryPolicy). Must not
+//              be called from an interrupt or a done callback.
+// Arguments:
+//  - uint8_t reg: address of the first register to read
+//  - uint8_t* buf: pointer to a buffer that receives the register values
+//  - uint8_t len: number of registers to read (at least 1)
+//
+// Returns:
+//  - 0: if the registers were succesfully read
+//  - 1: if a timeout error occured (on the last attempt)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Bus_Read(uint8_t reg, uint8_t* buf, uint8_t len)
+{
+  return DS3231_Bus_Transfer(OP_READ, DS3231_I2C_ADDRESS, reg, buf, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Write
+// Description: This function writes a block of consecutive registers of the DS3231 in one
+//              I2C transaction (START, address, register pointer, data bytes, STOP) and
+//              waits for the result. The DS3231 auto-increments its register pointer after
+//              every byte. Failed writes are retried (see DS3231_Bus_SetRetryPolicy). Must not
+//              be called from an interrupt or a done callback.
+// Arguments:
+//  - uint8_t reg: address of the first register to write
+//  - const uint8_t* buf: pointer to the values that will be written
+//  - uint8_t len: number of registers to write (0 to DS3231_BUS_MAX_WRITE, 0 only sets the
+//                 register pointer)
+//
+// Returns:
+//  - 0: if the registers were succesfully written
+//  - 1: if a timeout error occured (on the last attempt)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Bus_Write(uint8_t reg, const uint8_t* buf, uint8_t len)
+{
+  return DS3231_Bus_Transfer(0, DS3231_I2C_ADDRESS, reg, (uint8_t*)buf, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_ReadFrom
+// Description: This function is DS3231_Bus_Read for a device at another I2C address (e.g.
+//              a second DS3231 behind an I2C multiplexer, see DS3231_Multi.h).
+// Arguments:
+//  - uint8_t addr: I2C address of the device (write form, bit 0 = 0)
+//  - see DS3231_Bus_Read for the other arguments
+//
+// Returns: see DS3231_Bus_Read
+uint8_t DS3231_Bus_ReadFrom(uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len)
+{
+  return DS3231_Bus_Transfer(OP_READ, addr, reg, buf, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_WriteTo
+// Description: This function is DS3231_Bus_Write for a device at another I2C address. With
+//              len = 0 only the byte reg is sent, which is how a TCA9548A multiplexer is set
+//              (the byte is its channel mask).
+// Arguments:
+//  - uint8_t addr: I2C address of the device (write form, bit 0 = 0)
+//  - see DS3231_Bus_Write for the other arguments
+//
+// Returns: see DS3231_Bus_Write
+uint8_t DS3231_Bus_WriteTo(uint8_t addr, uint8_t reg, const uint8_t* buf, uint8_t len)
+{
+  return DS3231_Bus_Transfer(0, addr, reg, (uint8_t*)buf, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_Recover
+// Description: This function frees a bus that is held by the DS3231, e.g. after the
+//              microcontroller was reset in the middle of a read, when the DS3231 still drives
+//              SDA low for the next data bit. The TWI hardware is disconnected from the pins.
+//              SCL is then pulsed (open drain, at the bus speed) until the DS3231 releases SDA,
+//              at most 9 times (enough to clock out any byte and its ack), and a stop
+//              condition resets the I2C state machine of the DS3231. Takes at most 23 half SCL
+//              periods (115 us at 100 kHz, 29 us at 400 kHz). Queued operations are kept: when
+//              the bus is free the active one is started again from its start condition, else
+//              (or before DS3231_Bus_Init) all of them are aborted and their done callbacks
+//              are called with status 1. Can be called before DS3231_Bus_Init (at 100 kHz, the
+//              TWI stays disabled).
+// Arguments: none
+//
+// Returns:
+//  - 0: if the bus is free (SDA and SCL high after the stop condition)
+//  - 1: if SCL is held low or SDA is still low, the bus can not be freed by the master
+uint8_t DS3231_Bus_Recover(void)
+{
+  uint16_t half = (scl_freq != 0) ? (uint16_t)((500000UL + scl_freq - 1) / scl_freq) : 5; // half SCL period in us
+  uint8_t pulses = 0;
+  uint8_t ret = 0;
+
+  TWCR = 0; // the pins become normal port pins and the TWI interrupt stops, also drops a stop condition that can not complete
+  SDA_RELEASE();
+  SCL_RELEASE();
+  Timer0_Delay_us(half);
+
+  if(!SCL_READ())
+    ret = 1; // SCL is held low (clock stretching that does not end, or a short)
+  while(ret == 0 && !SDA_READ() && pulses < 9)
+  {
+    SCL_LOW();
+    Timer0_Delay_us(half);
+    SCL_RELEASE();
+    Timer0_Delay_us(half);
+    pulses++;
+    if(!SCL_READ())
+      ret = 1;
+  }
+  if(ret == 0)
+  {
+    // stop condition: SDA goes high while SCL is high
+    SCL_LOW();
+    Timer0_Delay_us(half);
+    SDA_LOW();
+    Timer0_Delay_us(half);
+    SCL_RELEASE();
+    Timer0_Delay_us(half);
+    SDA_RELEASE();
+    Timer0_Delay_us(half);
+    if(!SDA_READ() || !SCL_READ())
+      ret = 1;
+  }
+
+  if(scl_freq != 0)
+    TWCR = (1<<TWEN); // hand the pins back to the TWI hardware
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if(q_count != 0 && ret == 0 && scl_freq != 0)
+    {
+      idx = 0; // the active operation starts again, the queued ones follow it
+      state = ST_START;
+      DS3231_TWI_Action(1<<TWSTA);
+    }
+    else if(q_count != 0)
+    {
+      DS3231_TRACE_EVENT(DS3231_EV_ABORT, 0, q_count);
+      while(q_count > 0) // the bus is still stuck, every queued operation would time out
+      {
+        void (*done)(uint8_t) = queue[q_head].done;
+        STATS_OP_DONE(&queue[q_head], 1);
+        q_head = (q_head + 1) % DS3231_BUS_QUEUE_SIZE;
+        q_count--;
+        if(done != 0)
+          done(1);
+      }
+      state = ST_IDLE;
+      idx = 0;
+    }
+  }
+  bus_errors.recoveries++;
+  DS3231_STATS_RECOVERY();
+  DS3231_TRACE_EVENT(DS3231_EV_RECOVER, pulses, ret);
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_SetRetryPolicy
+// Description: This function sets how often DS3231_Bus_Read and DS3231_Bus_Write repeat a
+//              failed transfer. The first retry waits backoff_us, every further retry waits
+//              twice as long as the one before. The default is DS3231_BUS_RETRIES retries
+//              starting at DS3231_BUS_BACKOFF_US.
+// Arguments:
+//  - uint8_t retries: number of retries after the first attempt, 0 disables retrying
+//  - uint16_t backoff_us: wait before the first retry in us, 0 retries immediately
+//
+// Returns: nothing
+void DS3231_Bus_SetRetryPolicy(uint8_t retries, uint16_t backoff_us)
+{
+  retry_count = retries;
+  retry_backoff_us = backoff_us;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_GetErrors
+// Description: This function returns the retry and recovery counters since the last call of
+//              DS3231_Bus_ResetErrors.
+// Arguments:
+//  - struct DS3231_BusErrors* pErrors: pointer to a DS3231_BusErrors struct to store the counters
+//
+// Returns: nothing
+void DS3231_Bus_GetErrors(struct DS3231_BusErrors* pErrors)
+{
+  *pErrors = bus_errors;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_ResetErrors
+// Description: This function resets the retry and recovery counters to zero.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Bus_ResetErrors(void)
+{
+  bus_errors.retries = 0;
+  bus_errors.recoveries = 0;
+  bus_errors.failures = 0;
+}
+
+#ifdef DS3231_BUS_ACCOUNTING
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_GetCost
+// Description: This function returns the bus usage counted since the last call of
+//              DS3231_Bus_ResetCost. Only available when DS3231_BUS_ACCOUNTING is defined.
+// Arguments:
+//  - struct DS3231_BusCost* pCost: pointer to a DS3231_BusCost struct to store the counters
+//
+// Returns: nothing
+void DS3231_Bus_GetCost(struct DS3231_BusCost* pCost)
+{
+  *pCost = bus_cost;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_ResetCost
+// Description: This function resets the bus usage counters to zero. Only available when
+//              DS3231_BUS_ACCOUNTING is defined.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Bus_ResetCost(void)
+{
+  bus_cost.starts = 0;
+  bus_cost.stops = 0;
+  bus_cost.bytes = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Bus_EstimateTime_us
+// Description: This function estimates the time the counted bus usage takes on the wire:
+//              9 clock periods per byte (8 data bits and the ack) and one per start or stop
+//              condition. Only available when DS3231_BUS_ACCOUNTING is defined.
+// Arguments:
+//  - const struct DS3231_BusCost* pCost: pointer to the counted bus usage
+//  - uint32_t scl_freq: SCL frequency of the bus in Hz (e.g. 100000 or 400000)
+//
+// Returns: the estimated bus time in microseconds
+uint32_t DS3231_Bus_EstimateTime_us(const struct DS3231_BusCost* pCost, uint32_t scl_freq)
+{
+  uint32_t periods = (uint32_t)pCost->bytes*9 + pCost->starts + pCost->stops;
+  return (periods*1000000UL + scl_freq/2) / scl_freq;
+}
+#endif
@@ -0,0 +1,101 @@
+#ifndef DS3231_BUS_HEADER
+#define DS3231_BUS_HEADER
+
+// This header is shared by the modules of the DS3231 lib, it is not needed for using the lib.
+// All register accesses of the lib go through DS3231_Bus_Init, DS3231_Bus_Read and
+// DS3231_Bus_Write (DS3231_Bus_ReadFrom/WriteTo for devices at other addresses). These are
+// implemented in DS3231_Bus.c on top of the TWI hardware of the ATmega328 as an interrupt
+// driven transaction engine (the blocking functions wait on the same engine). On a host the
+// lib runs against a simulated DS3231 behind mock TWI registers (host/DS3231_Sim.h), so this
+// engine is tested as well.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// register map of the DS3231
+#define SECONDS_ADDRESS 0x00
+#define MINUTES_ADDRESS 0x01
+#define HOURS_ADDRESS 0x02
+#define DAY_ADDRESS 0x03
+#define DATE_ADDRESS 0x04
+#define MONTH_ADDRESS 0x05
+#define YEAR_ADDRESS 0x06
+
+#define ALARM1_SEC_ADDRESS 0x07
+#define ALARM1_MIN_ADDRESS 0x08
+#define ALARM1_HOUR_ADDRESS 0x09
+#define ALARM1_DYDT_ADDRESS 0x0A
+
+#define ALARM2_MIN_ADDRESS 0x0B
+#define ALARM2_HOUR_ADDRESS 0x0C
+#define ALARM2_DYDT_ADDRESS 0x0D
+
+#define CTRL_ADDRESS 0x0E
+#define STATUS_ADDRESS 0x0F
+#define AGING_ADDRESS 0x10
+#define TEMP_MSB_ADDRESS 0x11
+#define TEMP_LSB_ADDRESS 0x12
+
+#define REGISTER_COUNT 0x13 // number of registers in the DS3231 (0x00 to 0x12)
+
+#define DS3231_BUS_QUEUE_SIZE 4 // number of operations that can be queued on the transaction engine
+#define DS3231_BUS_MAX_WRITE 8 // maximum number of registers written by one operation
+
+// default retry policy of DS3231_Bus_Read and DS3231_Bus_Write (see DS3231_Bus_SetRetryPolicy)
+#ifndef DS3231_BUS_RETRIES
+#define DS3231_BUS_RETRIES 2 // retries after a failed attempt
+#endif
+#ifndef DS3231_BUS_BACKOFF_US
+#define DS3231_BUS_BACKOFF_US 100 // wait before the first retry, doubled on every further retry
+#endif
+#ifndef DS3231_BUS_TIMEOUT_US
+#define DS3231_BUS_TIMEOUT_US 20000 // a transfer without bus progress for this long is aborted (code 1), converted into polling iterations by DS3231_Bus_Init
+#endif
+
+// free running hardware counter used by the lib for measuring short durations (wake-up latency,
+// statistics). The default is Timer1, which the application must let run freely (e.g. as set up
+// by DS3231_Timestamp_Start). Define DS3231_TICKS before compiling the lib to use another
+// counter, or a mock on a host.
+#ifndef DS3231_TICKS
+#define DS3231_TICKS() (TCNT1)
+#endif
+
+// bus usage counters, only maintained when DS3231_BUS_ACCOUNTING is defined
+struct DS3231_BusCost
+{
+  uint16_t starts; // number of start and repeated start conditions
+  uint16_t stops; // number of stop conditions (one per transaction)
+  uint16_t bytes; // number of bytes on the wire (address, register pointer and data bytes)
+};
+
+struct DS3231_BusErrors; // see DS3231.h
+
+// bus function prototypes (for use by the modules of the DS3231 lib)
+uint8_t DS3231_Bus_Init(uint32_t cpu_freq, uint32_t bus_speed);
+uint32_t DS3231_Bus_GetFrequency(void);
+uint8_t DS3231_Bus_Read(uint8_t reg, uint8_t* buf, uint8_t len);
+uint8_t DS3231_Bus_Write(uint8_t reg, const uint8_t* buf, uint8_t len);
+uint8_t DS3231_Bus_ReadFrom(uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len);
+uint8_t DS3231_Bus_WriteTo(uint8_t addr, uint8_t reg, const uint8_t* buf, uint8_t len);
+uint8_t DS3231_Bus_ReadAsync(uint8_t reg, uint8_t* buf, uint8_t len, void (*post)(uint8_t* buf), void (*done)(uint8_t status));
+uint8_t DS3231_Bus_WriteAsync(uint8_t reg, const uint8_t* buf, uint8_t len, void (*done)(uint8_t status));
+void DS3231_Bus_Abort(void);
+uint8_t DS3231_Bus_Busy(void);
+uint8_t DS3231_Bus_Recover(void);
+void DS3231_Bus_SetRetryPolicy(uint8_t retries, uint16_t backoff_us);
+void DS3231_Bus_GetErrors(struct DS3231_BusErrors* pErrors);
+void DS3231_Bus_ResetErrors(void);
+#ifdef DS3231_BUS_ACCOUNTING
+void DS3231_Bus_GetCost(struct DS3231_BusCost* pCost);
+void DS3231_Bus_ResetCost(void);
+uint32_t DS3231_Bus_EstimateTime_us(const struct DS3231_BusCost* pCost, uint32_t scl_freq);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+#include "DS3231.h"
+#include "DS3231_Calib.h"
+#include "DS3231_Stats.h"
+#include "DS3231_Timestamp.h"
+#include <util/atomic.h>
+
+// a reference event and the DS3231 timestamp at that moment
+struct CalibMark
+{
+  uint32_t ref; // reference time in seconds
+  uint32_t seconds; // DS3231_ReadTimestamp
+  uint16_t subsec;
+};
+
+static volatile struct CalibMark pending; // latest mark, not yet used by DS3231_Calib_Service
+static volatile uint8_t pending_valid = 0;
+static struct CalibMark base; // start of the interval being measured
+static uint8_t base_valid = 0;
+static uint16_t interval; // shortest interval in seconds
+static struct DS3231_CalibStatus status;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Calib_Start
+// Description: This function reads the aging offset of the DS3231 and resets the clock
+//              discipline (filter, counters and the interval being measured). The
+//              timestamp counter must already be running (DS3231_Timestamp_Start).
+// Arguments:
+//  - uint16_t min_interval: shortest interval between two reference events that gives a
+//                           sample, in seconds (0 selects DS3231_CALIB_MIN_INTERVAL). The
+//                           resolution of a sample is 30.5 us divided by the interval.
+//
+// Returns:
+//  - 0: if the clock discipline was started
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Calib_Start(uint16_t min_interval)
+{
+  DS3231_STATS_FUNC(DS3231_FN_CALIB_START);
+  int8_t aging;
+  uint8_t ret = DS3231_ReadAgingOffset(&aging);
+  if(ret != 0)
+    return ret;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    pending_valid = 0;
+  }
+  base_valid = 0;
+  interval = (min_interval != 0) ? min_interval : DS3231_CALIB_MIN_INTERVAL;
+  status.drift_ppb = 0;
+  status.aging = aging;
+  status.valid = 0;
+  status.samples = 0;
+  status.adjustments = 0;
+  status.rejected = 0;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Calib_Mark
+// Description: This function records a reference event: the reference time and the
+//              timestamp of the DS3231 at this moment. It does not use the bus and may be
+//              called from an interrupt (e.g. the PPS pin of a GPS receiver). Only the
+//              latest mark is kept until DS3231_Calib_Service uses it.
+// Arguments:
+//  - uint32_t ref_seconds: the reference time in seconds (any origin, e.g. a count of PPS
+//                          pulses or the unix time of the host)
+//
+// Returns: nothing
+void DS3231_Calib_Mark(uint32_t ref_seconds)
+{
+  DS3231_STATS_FUNC(DS3231_FN_CALIB_MARK);
+  uint32_t seconds;
+  uint16_t subsec;
+
+  DS3231_ReadTimestamp(&seconds, &subsec);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    pending.ref = ref_seconds;
+    pending.seconds = seconds;
+    pending.subsec = subsec;
+    pending_valid = 1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Calib_ErrorPpb
+// Description: This function converts the difference between the DS3231 and the reference
+//              over an interval to ppb: err / (32768 * seconds) * 1e9. With err = q*seconds + r
+//              this is q*1e9/32768 + r*1e9/32768/seconds, 1e9/32768 = 30517 + 37/64, so all
+//              products fit into 32 bits.
+// Arguments:
+//  - int32_t err: difference (DS3231 - reference) in 1/32768 s, at most about 100 ppm
+//  - uint16_t seconds: length of the interval (reference) in seconds, at least 1
+//
+// Returns: the frequency error in ppb, positive if the DS3231 runs fast
+static int32_t DS3231_Calib_ErrorPpb(int32_t err, uint16_t seconds)
+{
+  int32_t q = err / seconds;
+  int32_t r = err % seconds;
+  return q*1953125/64 + (r*30517 + r*37/64) / seconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Calib_Service
+// Description: This function uses the latest reference event: once it is at least
+//              min_interval seconds after the start of the current interval the interval
+//              gives a sample of the frequency error, which is fed into the filter (the next
+//              interval starts at this event). When the filtered error is outside the dead
+//              band after enough samples the aging offset is corrected by the rounded error,
+//              limited to DS3231_CALIB_MAX_STEP steps, and the filter is shifted by the
+//              expected effect. Because the frequency changes with the next temperature
+//              conversion, the interval after an adjustment starts at the next event.
+//              Without a new event the function returns at once and does not use the bus.
+// Arguments: none
+//
+// Returns:
+//  - 0: if there was nothing to do or the sample was used
+//  - 2: if the interval was rejected: the error is above about 100 ppm (a reference event
+//       was missed or counted twice) or the interval is longer than 65535 s; the next
+//       interval starts at this event
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Calib_Service(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_CALIB_SERVICE);
+  struct CalibMark mark;
+  uint32_t seconds;
+  int32_t err, ppb, steps;
+  int16_t aging;
+  uint8_t valid, ret;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    valid = pending_valid;
+    mark.ref = pending.ref;
+    mark.seconds = pending.seconds;
+    mark.subsec = pending.subsec;
+    pending_valid = 0;
+  }
+  if(!valid)
+    return 0;
+  if(!base_valid)
+  {
+    base = mark;
+    base_valid = 1;
+    return 0;
+  }
+
+  seconds = mark.ref - base.ref;
+  if(seconds < interval)
+    return 0; // keep the start of the interval, a later event gives a longer one
+  err = (int32_t)(mark.seconds - base.seconds - seconds); // whole seconds, -1 to 1 for a valid interval
+  if(seconds <= 0xFFFF && err >= -1 && err <= 1)
+    err = err * 32768 + (int32_t)mark.subsec - base.subsec;
+  else
+    err = 0x7FFFFFFF; // rejected below
+  base = mark;
+  if(seconds > 0xFFFF || (uint32_t)(err < 0 ? -err : err) > seconds*27/8) // 27/8 ticks per second = 103 ppm
+  {
+    status.rejected++;
+    return 2;
+  }
+
+  ppb = DS3231_Calib_ErrorPpb(err, seconds);
+  if(!status.valid)
+    status.drift_ppb = ppb;
+  else
+    status.drift_ppb += (ppb - status.drift_ppb) / (1 << DS3231_CALIB_FILTER_SHIFT);
+  status.valid = 1;
+  if(status.samples < 255)
+    status.samples++;
+
+  if(status.samples < DS3231_CALIB_MIN_SAMPLES ||
+     (status.drift_ppb < DS3231_CALIB_DEADBAND_PPB && status.drift_ppb > -DS3231_CALIB_DEADBAND_PPB))
+    return 0;
+
+  // the DS3231 runs fast: a larger offset slows it down
+  steps = (status.drift_ppb + (status.drift_ppb > 0 ? DS3231_CALIB_PPB_PER_STEP/2 : -DS3231_CALIB_PPB_PER_STEP/2)) / DS3231_CALIB_PPB_PER_STEP;
+  if(steps > DS3231_CALIB_MAX_STEP)
+    steps = DS3231_CALIB_MAX_STEP;
+  else if(steps < -DS3231_CALIB_MAX_STEP)
+    steps = -DS3231_CALIB_MAX_STEP;
+  aging = status.aging + steps;
+  if(aging > 127)
+    aging = 127;
+  else if(aging < -128)
+    aging = -128;
+  if(aging == status.aging)
+    return 0; // end of the range of the aging offset
+
+  ret = DS3231_SetAgingOffset((int8_t)aging);
+  if(ret != 0)
+    return ret;
+  status.drift_ppb -= (aging - status.aging) * (int32_t)DS3231_CALIB_PPB_PER_STEP;
+  status.aging = (int8_t)aging;
+  status.samples = 0;
+  status.adjustments++;
+  base_valid = 0;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Calib_GetStatus
+// Description: This function returns the estimated drift, the aging offset and the
+//              counters of the clock discipline.
+// Arguments:
+//  - struct DS3231_CalibStatus* pStatus: pointer to a DS3231_CalibStatus struct to store the
+//                                        state
+//
+// Returns: nothing
+void DS3231_Calib_GetStatus(struct DS3231_CalibStatus* pStatus)
+{
+  *pStatus = status;
+}
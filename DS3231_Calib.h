@@ -0,0 +1,62 @@
+#ifndef DS3231_CALIB_HEADER
+#define DS3231_CALIB_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Clock discipline: the frequency error of the DS3231 is measured against a reference (GPS PPS,
+// timestamps of a host, ...) and corrected with the aging offset register.
+// The DS3231 side is measured with the sub-second timestamps of DS3231_Timestamp (32kHz output
+// counted by Timer1, 30.5 us resolution), so DS3231_Timestamp_Start must have been called. The
+// application calls DS3231_Calib_Mark on every reference event with the reference time in
+// seconds, e.g. from the interrupt of the PPS pin (counting the pulses) or when a timestamp of
+// the host arrives over the USART, and DS3231_Calib_Service from the main loop. A constant
+// latency between the event and DS3231_Calib_Mark cancels out, jitter is averaged by the
+// filter.
+// Every interval of at least min_interval seconds gives one sample of the frequency error. The
+// samples go through a first order IIR filter, when at least DS3231_CALIB_MIN_SAMPLES samples
+// agree on an error of more than DS3231_CALIB_DEADBAND_PPB the aging offset is moved by at most
+// DS3231_CALIB_MAX_STEP steps (about 0.1 ppm each) and a temperature conversion applies it.
+
+#ifndef DS3231_CALIB_MIN_INTERVAL
+#define DS3231_CALIB_MIN_INTERVAL 900 // default shortest measured interval in seconds (34 ppb resolution)
+#endif
+#ifndef DS3231_CALIB_FILTER_SHIFT
+#define DS3231_CALIB_FILTER_SHIFT 2 // the filter moves by 1/2^shift of the difference to a new sample
+#endif
+#ifndef DS3231_CALIB_MIN_SAMPLES
+#define DS3231_CALIB_MIN_SAMPLES 4 // samples after the start or an adjustment before the next adjustment
+#endif
+#ifndef DS3231_CALIB_DEADBAND_PPB
+#define DS3231_CALIB_DEADBAND_PPB 60 // smaller errors are not corrected (one step would overshoot)
+#endif
+#ifndef DS3231_CALIB_MAX_STEP
+#define DS3231_CALIB_MAX_STEP 4 // largest change of the aging offset per adjustment
+#endif
+#define DS3231_CALIB_PPB_PER_STEP 100 // nominal effect of one step of the aging offset at 25 degree Celsius
+
+// state of the clock discipline, see DS3231_Calib_GetStatus
+struct DS3231_CalibStatus
+{
+  int32_t drift_ppb; // filtered frequency error at the current aging offset in ppb, positive: the DS3231 runs fast (1000 ppb = 2.6 s per month)
+  int8_t aging; // current aging offset
+  uint8_t valid; // 1 if drift_ppb is based on at least one sample
+  uint8_t samples; // samples since the start or the last adjustment
+  uint16_t adjustments; // number of changes of the aging offset
+  uint16_t rejected; // number of intervals that were rejected (error above 100 ppm, missing reference event)
+};
+
+// public function prototypes
+uint8_t DS3231_Calib_Start(uint16_t min_interval);
+void DS3231_Calib_Mark(uint32_t ref_seconds);
+uint8_t DS3231_Calib_Service(void);
+void DS3231_Calib_GetStatus(struct DS3231_CalibStatus* pStatus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
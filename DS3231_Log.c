@@ -0,0 +1,221 @@
+#include "DS3231.h"
+#include "DS3231_Log.h"
+#include "DS3231_Stats.h"
+
+#ifndef DS3231_LOG_READ
+#include <avr/eeprom.h>
+#define DS3231_LOG_READ(addr) eeprom_read_byte((const uint8_t*)(addr))
+#define DS3231_LOG_WRITE(addr, value) eeprom_update_byte((uint8_t*)(addr), (value))
+#define DS3231_LOG_ERASE(addr) DS3231_Log_EraseBytes(addr)
+#define LOG_EEPROM
+#endif
+
+#define LOG_SEQ_EMPTY 0xFFFF // sequence number of an erased block
+#define LOG_BLOCK_ADDRESS(block) (DS3231_LOG_START + (uint16_t)(block) * DS3231_LOG_BLOCK_SIZE)
+#define LOG_MAX_DELTA (0xFFFFFFFFUL >> DS3231_LOG_ID_BITS) // larger deltas start a new block
+
+static uint8_t block; // block that is currently written
+static uint8_t pos; // offset of the next record in the block, 0 if no block has been started
+static uint16_t seq; // sequence number of the current block
+static uint32_t last_epoch; // time of the last event
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Log_EraseBytes
+// Description: This function erases a block by writing 0xFF to every byte (bytes that are
+//              already 0xFF are not written by eeprom_update_byte).
+// Arguments:
+//  - uint16_t addr: first address of the block
+//
+// Returns: nothing
+#ifdef LOG_EEPROM
+static void DS3231_Log_EraseBytes(uint16_t addr)
+{
+  uint8_t i;
+  for(i = 0; i < DS3231_LOG_BLOCK_SIZE; i++)
+    DS3231_LOG_WRITE(addr + i, 0xFF);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Log_ReadSeq
+// Description: This function reads the sequence number of a block.
+// Arguments:
+//  - uint8_t b: the block
+//
+// Returns: the sequence number, LOG_SEQ_EMPTY if the block is erased
+static uint16_t DS3231_Log_ReadSeq(uint8_t b)
+{
+  uint16_t addr = LOG_BLOCK_ADDRESS(b);
+  return DS3231_LOG_READ(addr) | ((uint16_t)DS3231_LOG_READ(addr + 1) << 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Log_Init
+// Description: This function finds the end of the log after a reset: the newest block is
+//              the one with the highest sequence number (compared with wrap around), its
+//              records are decoded up to a 0xFF at the start of a record (inside a record 0xFF
+//              is a valid byte) to find the next free offset and the time of the last event.
+//              A record that was cut by a power loss is overwritten by the next event. Only the
+//              storage is read, the bus is not used.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Log_Init(void)
+{
+  uint16_t addr, s;
+  uint32_t v;
+  uint8_t b, i, shift, byte = 0;
+
+  pos = 0;
+  for(b = 0; b < DS3231_LOG_BLOCKS; b++)
+  {
+    s = DS3231_Log_ReadSeq(b);
+    if(s == LOG_SEQ_EMPTY)
+      continue;
+    if(pos == 0 || (int16_t)(s - seq) > 0)
+    {
+      block = b;
+      seq = s;
+      pos = DS3231_LOG_HEADER_SIZE;
+    }
+  }
+  if(pos == 0)
+    return; // empty log
+
+  addr = LOG_BLOCK_ADDRESS(block);
+  last_epoch = 0;
+  for(i = 0; i < 4; i++)
+    last_epoch |= (uint32_t)DS3231_LOG_READ(addr + 2 + i) << (8*i);
+
+  while(pos < DS3231_LOG_BLOCK_SIZE && DS3231_LOG_READ(addr + pos) != 0xFF)
+  {
+    v = 0;
+    shift = 0;
+    for(i = pos; i < DS3231_LOG_BLOCK_SIZE && shift < 35; i++) // 0xFF is a valid continuation byte, e.g. 82 FF 01
+    {
+      byte = DS3231_LOG_READ(addr + i);
+      v |= (uint32_t)(byte & 0x7F) << shift;
+      shift += 7;
+      if(!(byte & 0x80))
+        break;
+    }
+    if(byte & 0x80)
+      break; // cut record (runs past the block end or the 5 bytes of a 32 bit varint), the next event overwrites it
+    last_epoch += v >> DS3231_LOG_ID_BITS;
+    pos = i + 1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Log_Clear
+// Description: This function erases every block completely (DS3231_LOG_ERASE), the log is
+//              empty afterwards. With the default EEPROM storage every byte of the log that is
+//              not already 0xFF costs an EEPROM write cycle (3.4 ms each on the ATmega328,
+//              about 3.5 s for the full 1 KB) and one erase/write of its endurance.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Log_Clear(void)
+{
+  uint8_t b;
+  for(b = 0; b < DS3231_LOG_BLOCKS; b++)
+    DS3231_LOG_ERASE(LOG_BLOCK_ADDRESS(b));
+  pos = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Log_EventAt
+// Description: This function appends an event with a given time, e.g. when several events
+//              are stamped with one read of the time. The record holds the seconds since the
+//              previous event. When it does not fit into the current block, the time went
+//              backwards or the log is empty the next block of the ring is erased and
+//              started with a keyframe (the oldest block is overwritten).
+// Arguments:
+//  - uint8_t id: the event (0 to DS3231_LOG_MAX_ID)
+//  - uint32_t epoch: time of the event (unix time, see DS3231_ReadEpoch)
+//
+// Returns:
+//  - 0: if the event was written
+//  - 2: if the id is invalid
+uint8_t DS3231_Log_EventAt(uint8_t id, uint32_t epoch)
+{
+  uint8_t buf[5], len = 0, i;
+  uint16_t addr;
+  uint32_t v;
+
+  if(id > DS3231_LOG_MAX_ID)
+    return 2;
+
+  if(pos != 0 && epoch >= last_epoch && epoch - last_epoch <= LOG_MAX_DELTA)
+  {
+    v = ((epoch - last_epoch) << DS3231_LOG_ID_BITS) | id;
+    do
+    {
+      buf[len] = v & 0x7F;
+      v >>= 7;
+      if(v != 0)
+        buf[len] |= 0x80;
+      len++;
+    } while(v != 0);
+  }
+
+  if(len == 0 || pos + len > DS3231_LOG_BLOCK_SIZE)
+  {
+    if(pos != 0)
+    {
+      block = (block + 1 < DS3231_LOG_BLOCKS) ? block + 1 : 0;
+      if(++seq == LOG_SEQ_EMPTY)
+        seq = 0;
+    }
+    else
+    {
+      block = 0;
+      seq = 0;
+    }
+    addr = LOG_BLOCK_ADDRESS(block);
+    DS3231_LOG_ERASE(addr);
+    for(i = 0; i < 4; i++)
+      DS3231_LOG_WRITE(addr + 2 + i, (uint8_t)(epoch >> (8*i)));
+    DS3231_LOG_WRITE(addr, (uint8_t)seq); // the sequence number last, it makes the block valid
+    DS3231_LOG_WRITE(addr + 1, (uint8_t)(seq >> 8));
+    pos = DS3231_LOG_HEADER_SIZE;
+    buf[0] = id; // delta 0 to the keyframe
+    len = 1;
+  }
+
+  addr = LOG_BLOCK_ADDRESS(block) + pos;
+  for(i = 0; i < len; i++)
+    DS3231_LOG_WRITE(addr + i, buf[i]);
+  pos += len;
+  last_epoch = epoch;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Log_Event
+// Description: This function appends an event stamped with the current time, read with
+//              DS3231_ReadEpoch (one burst read, no bus traffic while the software clock
+//              runs).
+// Arguments:
+//  - uint8_t id: the event (0 to DS3231_LOG_MAX_ID)
+//
+// Returns:
+//  - 0: if the event was written
+//  - 1: if a timeout error occured in the TWI driver
+//  - 2: if the id is invalid or the time of the DS3231 can not be represented (nothing is
+//       written)
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Log_Event(uint8_t id)
+{
+  DS3231_STATS_FUNC(DS3231_FN_LOG_EVENT);
+  uint32_t epoch;
+  uint8_t ret;
+
+  if(id > DS3231_LOG_MAX_ID)
+    return 2;
+  ret = DS3231_ReadEpoch(&epoch);
+  if(ret != 0)
+    return ret;
+  return DS3231_Log_EventAt(id, epoch);
+}
@@ -0,0 +1,54 @@
+#ifndef DS3231_LOG_HEADER
+#define DS3231_LOG_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timestamped event log in the EEPROM of the ATmega328 (or an external memory, see below).
+// The storage is a ring of blocks. Every block starts with a header: a 16 bit sequence number
+// (the block with the highest one is the newest) and a keyframe, the full unix time of the first
+// event in the block. After the header come the events, each one a single varint (7 bits per
+// byte, low bits first, bit 7 set on all but the last byte) of
+//   (seconds since the previous event << DS3231_LOG_ID_BITS) | id
+// so an event within 7 s of the previous one takes 1 byte, within 17 minutes 2 bytes, within
+// 36 hours 3 bytes. A new block (with a new keyframe) is started when the event does not fit
+// into the current one or the time went backwards. The blocks are written in ring order, so
+// every byte of the storage is written about once per ring cycle (wear levelling); unused bytes
+// are 0xFF. The log is decoded on a host from a raw dump of the storage with
+// tools/DS3231_LogDecode.c (keep it in sync with the defaults below).
+//
+// The storage is accessed with DS3231_LOG_READ(addr), DS3231_LOG_WRITE(addr, value) and
+// DS3231_LOG_ERASE(addr) (sets the block at addr to 0xFF), by default eeprom_read_byte and
+// eeprom_update_byte. Define all three before compiling DS3231_Log.c to log into an external
+// memory, e.g. a flash with a sector erase.
+
+#ifndef DS3231_LOG_START
+#define DS3231_LOG_START 0 // first address of the storage
+#endif
+#ifndef DS3231_LOG_BLOCKS
+#define DS3231_LOG_BLOCKS 32 // number of blocks in the ring
+#endif
+#ifndef DS3231_LOG_BLOCK_SIZE
+#define DS3231_LOG_BLOCK_SIZE 32 // bytes per block, header included (32 blocks of 32 bytes = the 1 KB EEPROM)
+#endif
+#ifndef DS3231_LOG_ID_BITS
+#define DS3231_LOG_ID_BITS 4 // bits of the event id in a record (1 to 7)
+#endif
+
+#define DS3231_LOG_HEADER_SIZE 6 // sequence number (2 bytes) and keyframe (4 bytes), little endian
+#define DS3231_LOG_MAX_ID ((1 << DS3231_LOG_ID_BITS) - 2) // largest event id, the all ones id is reserved (a record never starts with 0xFF)
+
+// public function prototypes
+void DS3231_Log_Init(void);
+void DS3231_Log_Clear(void);
+uint8_t DS3231_Log_Event(uint8_t id);
+uint8_t DS3231_Log_EventAt(uint8_t id, uint32_t epoch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
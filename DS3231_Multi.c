@@ -0,0 +1,232 @@
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Bcd.h"
+#include "DS3231_Multi.h"
+#include "DS3231_Stats.h"
+
+#define TIME_LEN (YEAR_ADDRESS + 1) // registers 0x00 to 0x06: date and time
+#define FLAGS_LEN (STATUS_ADDRESS - CTRL_ADDRESS + 1) // registers 0x0E and 0x0F: control and status
+
+// routing of the bus, as last written to the muxes
+static uint8_t sel_mux = DS3231_NO_MUX; // mux with an enabled channel, DS3231_NO_MUX if all channels are off
+static uint8_t sel_channel; // the enabled channel of sel_mux
+static uint8_t sel_valid = 0; // 0 until the first selection (the state of the muxes is unknown after a reset of the ATmega328)
+static uint8_t known_muxes = 0; // bit n set if a handle behind DS3231_MUX_ADDRESS(n) was initialized
+
+// handles of DS3231_Dev_Init, a DS3231 without mux can not share the bus with another DS3231
+static struct DS3231_Dev* direct_dev = 0; // the handle without mux, 0 if there is none
+static uint8_t muxed_devs = 0; // 1 once a handle behind a mux was initialized
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Multi_Key
+// Description: This function returns the sort key of a device for DS3231_ReadAllDateTimes,
+//              devices with the same key are read without switching the mux.
+// Arguments:
+//  - const struct DS3231_Dev* dev: the device
+//
+// Returns: the key, the devices of the current selection have the lowest key
+static uint16_t DS3231_Multi_Key(const struct DS3231_Dev* dev)
+{
+  if(sel_valid && dev->mux_address == sel_mux && (sel_mux == DS3231_NO_MUX || dev->mux_channel == sel_channel))
+    return 0; // no switch needed
+  if(dev->mux_address == DS3231_NO_MUX)
+    return 1;
+  return ((uint16_t)dev->mux_address << 3) + dev->mux_channel + 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Dev_Init
+// Description: This function fills in the handle of a DS3231, nothing is sent on the bus. A
+//              DS3231 without mux answers on every mux channel, so it must be the only
+//              device: a handle without mux is refused when another handle was initialized
+//              (with or without mux), a handle behind a mux when one without mux exists.
+// Arguments:
+//  - struct DS3231_Dev* dev: the handle
+//  - uint8_t mux_address: DS3231_MUX_ADDRESS(n) of the TCA9548A the DS3231 is connected to,
+//                         DS3231_NO_MUX if it is directly on the bus
+//  - uint8_t mux_channel: channel of the mux (0 to 7), ignored without mux
+//
+// Returns:
+//  - 0: if the handle was filled in
+//  - 2: if the channel is invalid or the device would collide with another one (see above)
+uint8_t DS3231_Dev_Init(struct DS3231_Dev* dev, uint8_t mux_address, uint8_t mux_channel)
+{
+  if(mux_address != DS3231_NO_MUX && mux_channel > 7)
+    return 2;
+  if(direct_dev != 0 && direct_dev != dev)
+    return 2; // a DS3231 without mux is on the bus
+  if(mux_address == DS3231_NO_MUX && muxed_devs)
+    return 2; // it would answer together with the devices behind the muxes
+
+  if(mux_address == DS3231_NO_MUX)
+    direct_dev = dev;
+  else
+  {
+    muxed_devs = 1;
+    direct_dev = 0; // (dev was the handle without mux, if any)
+    known_muxes |= (uint8_t)(1 << ((mux_address >> 1) & 0x07));
+  }
+
+  dev->address = DS3231_I2C_ADDRESS;
+  dev->mux_address = mux_address;
+  dev->mux_channel = (mux_address != DS3231_NO_MUX) ? mux_channel : 0;
+  dev->ctrl = 0;
+  dev->status = 0;
+  dev->last_error = 0;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Dev_Select
+// Description: This function routes the bus to a DS3231: the channel of the previously
+//              selected mux is switched off when another mux (or a DS3231 without mux) is
+//              selected, then the channel of the device is switched on. While the state of the
+//              muxes is unknown (before the first selection, after a failed one) all channels of
+//              every mux of DS3231_Dev_Init but the one of the device are switched off instead,
+//              a channel left on would let two DS3231 answer. Nothing is sent when the device
+//              is already selected. After a switch the single device API (DS3231.h)
+//              talks to this device, its shadow registers are invalidated.
+// Arguments:
+//  - struct DS3231_Dev* dev: the device, last_error is set to the result
+//
+// Returns:
+//  - 0: if the device is selected
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors (e.g. 0x20: the mux did not
+//          answer), see TWI chapter in ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Dev_Select(struct DS3231_Dev* dev)
+{
+  DS3231_STATS_FUNC(DS3231_FN_DEV_SELECT);
+  uint8_t ret = 0;
+  uint8_t n;
+
+  if(DS3231_Multi_Key(dev) == 0)
+    return dev->last_error = 0;
+
+  if(sel_valid && sel_mux != DS3231_NO_MUX && sel_mux != dev->mux_address)
+    ret = DS3231_Bus_WriteTo(sel_mux, 0x00, 0, 0); // all channels of the previous mux off
+  for(n = 0; !sel_valid && ret == 0 && n < 8; n++)
+    if((known_muxes & (1 << n)) && DS3231_MUX_ADDRESS(n) != dev->mux_address)
+      ret = DS3231_Bus_WriteTo(DS3231_MUX_ADDRESS(n), 0x00, 0, 0); // a channel may be on since the reset or failure
+  if(ret == 0 && dev->mux_address != DS3231_NO_MUX)
+    ret = DS3231_Bus_WriteTo(dev->mux_address, (uint8_t)(1 << dev->mux_channel), 0, 0);
+
+  if(ret == 0)
+  {
+    sel_mux = dev->mux_address;
+    sel_channel = dev->mux_channel;
+    sel_valid = 1;
+  }
+  else
+    sel_valid = 0; // unknown which channels are on, write again on the next selection
+  DS3231_InvalidateCache();
+  return dev->last_error = ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Dev_ReadDateTime
+// Description: This function selects a DS3231 and reads its date and time, control and
+//              status register (see DS3231_ReadAllDateTimes).
+// Arguments:
+//  - struct DS3231_Dev* dev: the device, ctrl, status and last_error are updated
+//  - struct DS3231_DateTime* pDateTime: pointer to a DS3231_DateTime struct to store the
+//                                       read date and time
+//
+// Returns:
+//  - 0: if date and time were succesfully read
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Dev_ReadDateTime(struct DS3231_Dev* dev, struct DS3231_DateTime* pDateTime)
+{
+  DS3231_STATS_FUNC(DS3231_FN_DEV_READ_DATE_TIME);
+  DS3231_ReadAllDateTimes(dev, 1, pDateTime);
+  return dev->last_error;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Dev_SetDateTime
+// Description: This function selects a DS3231 and sets its date and time with
+//              DS3231_SetDateTime (one burst).
+// Arguments:
+//  - struct DS3231_Dev* dev: the device, last_error is updated
+//  - const struct DS3231_DateTime* pDateTime: the date and time to set
+//
+// Returns: see DS3231_SetDateTime
+uint8_t DS3231_Dev_SetDateTime(struct DS3231_Dev* dev, const struct DS3231_DateTime* pDateTime)
+{
+  DS3231_STATS_FUNC(DS3231_FN_DEV_SET_DATE_TIME);
+  uint8_t ret = DS3231_Dev_Select(dev);
+  if(ret == 0)
+    ret = DS3231_SetDateTime(pDateTime);
+  return dev->last_error = ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadAllDateTimes
+// Description: This function reads the date and time of several DS3231. Each device is read
+//              with a burst of registers 0x00 to 0x06 and one of 0x0E and 0x0F, which refreshes
+//              the ctrl and status fields of its handle (skipping the alarm registers saves 4
+//              bytes on the bus) (check DS3231_FLAG_OSF in status to find a clock
+//              that can not be trusted). The devices are read in the order that needs the
+//              fewest mux switches: first the devices of the current selection, then grouped by
+//              mux and channel. A failing device does not stop the others. With more than one
+//              device every device must be behind its own mux channel (see DS3231_Multi.h).
+// Arguments:
+//  - struct DS3231_Dev* devs: array of n device handles, last_error of each is set
+//  - uint8_t n: number of devices (1 to DS3231_MULTI_MAX)
+//  - struct DS3231_DateTime* out: array of n DS3231_DateTime structs, out[i] belongs to
+//                                 devs[i] (not changed if that device failed)
+//
+// Returns:
+//  - 0: if all devices were read
+//  - 2: if n is invalid, or n > 1 and a device has no mux or two devices share a channel
+//       (nothing is read)
+//  - 3: if at least one device failed, see last_error of the handles
+uint8_t DS3231_ReadAllDateTimes(struct DS3231_Dev* devs, uint8_t n, struct DS3231_DateTime* out)
+{
+  DS3231_STATS_FUNC(DS3231_FN_READ_ALL_DATE_TIMES);
+  uint8_t order[DS3231_MULTI_MAX];
+  uint16_t key;
+  uint8_t raw[TIME_LEN];
+  uint8_t flags[FLAGS_LEN];
+  uint8_t i, j, id, ret = 0;
+
+  if(n == 0 || n > DS3231_MULTI_MAX)
+    return 2;
+  for(i = 0; n > 1 && i < n; i++) // all devices behind a mux, one per channel, or they collide
+  {
+    if(devs[i].mux_address == DS3231_NO_MUX)
+      return 2;
+    for(j = 0; j < i; j++)
+      if(devs[j].mux_address == devs[i].mux_address && devs[j].mux_channel == devs[i].mux_channel)
+        return 2;
+  }
+
+  for(i = 0; i < n; i++) // insertion sort by key, devices with the same key stay in array order
+  {
+    key = DS3231_Multi_Key(&devs[i]);
+    for(j = i; j > 0 && DS3231_Multi_Key(&devs[order[j-1]]) > key; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  for(i = 0; i < n; i++)
+  {
+    id = order[i];
+    struct DS3231_Dev* dev = &devs[id];
+    if(DS3231_Dev_Select(dev) == 0)
+      dev->last_error = DS3231_Bus_ReadFrom(dev->address, SECONDS_ADDRESS, raw, TIME_LEN);
+    if(dev->last_error == 0)
+      dev->last_error = DS3231_Bus_ReadFrom(dev->address, CTRL_ADDRESS, flags, FLAGS_LEN);
+    if(dev->last_error != 0)
+    {
+      ret = 3;
+      continue;
+    }
+    DS3231_DecodeBCDBlock(raw, (uint8_t*)&out[id]); // the fields of DS3231_DateTime are in register order
+    dev->ctrl = flags[0];
+    dev->status = flags[1];
+  }
+  return ret;
+}
@@ -0,0 +1,56 @@
+#ifndef DS3231_MULTI_HEADER
+#define DS3231_MULTI_HEADER
+
+#include <stdint.h>
+#include "DS3231.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Several DS3231 on one bus. The address of the DS3231 can not be changed, so with more than
+// one DS3231 every one of them sits behind its own channel of a TCA9548A I2C multiplexer: a
+// DS3231 directly on the bus (DS3231_NO_MUX) answers whatever channel is switched on and would
+// collide with every device behind a mux, it can only be the single device. DS3231_Dev_Init
+// refuses a second handle without mux and a mix of handles with and without mux,
+// DS3231_ReadAllDateTimes a set with such a handle or two handles on the same channel. A device is described
+// by a struct DS3231_Dev handle (mux and channel, the last read control and status register and
+// the result of the last operation). DS3231_ReadAllDateTimes reads a set of devices with two
+// bursts per device, ordered so the mux channels are switched as rarely as possible.
+//
+// The single device API (DS3231.h) talks to the DS3231 that is currently routed to the bus, select
+// it with DS3231_Dev_Select first. Switching to another device invalidates the shadow registers
+// of DS3231.c (DS3231_InvalidateCache). The software clock and the modules built on it
+// (DS3231_Sched, DS3231_Sleep, DS3231_Timestamp) must only be used with one device.
+
+// I2C address (write form) of a TCA9548A, a2a1a0 = level of its address pins (0 to 7)
+#define DS3231_MUX_ADDRESS(a2a1a0) ((uint8_t)((0x70 + (a2a1a0)) << 1))
+#define DS3231_NO_MUX 0 // mux_address of a DS3231 that is directly on the bus
+
+#ifndef DS3231_MULTI_MAX
+#define DS3231_MULTI_MAX 16 // maximum number of devices of DS3231_ReadAllDateTimes
+#endif
+
+// handle of one DS3231
+struct DS3231_Dev
+{
+  uint8_t address; // I2C address (write form) of the DS3231, DS3231_I2C_ADDRESS
+  uint8_t mux_address; // DS3231_MUX_ADDRESS(n) or DS3231_NO_MUX
+  uint8_t mux_channel; // channel of the mux (0 to 7)
+  uint8_t ctrl; // control register, from the last DS3231_ReadAllDateTimes
+  uint8_t status; // status register, from the last DS3231_ReadAllDateTimes (DS3231_FLAG_OSF: time not valid)
+  uint8_t last_error; // result code of the last operation on the device (0 = ok)
+};
+
+// public function prototypes
+uint8_t DS3231_Dev_Init(struct DS3231_Dev* dev, uint8_t mux_address, uint8_t mux_channel);
+uint8_t DS3231_Dev_Select(struct DS3231_Dev* dev);
+uint8_t DS3231_Dev_ReadDateTime(struct DS3231_Dev* dev, struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_Dev_SetDateTime(struct DS3231_Dev* dev, const struct DS3231_DateTime* pDateTime);
+uint8_t DS3231_ReadAllDateTimes(struct DS3231_Dev* devs, uint8_t n, struct DS3231_DateTime* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+#include "DS3231.h"
+#include "DS3231_Sched.h"
+#include "DS3231_Stats.h"
+
+#define MAX_ALARM_AHEAD (27UL*86400) // alarm 1 matches the day of the month, never program it further ahead than the shortest month
+
+// a logical alarm
+struct SchedEntry
+{
+  uint32_t due; // next deadline (seconds since 2000)
+  uint32_t period; // period in seconds, 0 for a one-shot alarm
+  DS3231_SchedCallback callback;
+};
+
+static struct SchedEntry entries[DS3231_SCHED_MAX];
+static uint8_t order[DS3231_SCHED_MAX]; // ids of the active entries sorted by due, order[0] is the earliest
+static uint8_t count = 0; // number of active entries
+static uint32_t programmed; // deadline that is currently programmed into alarm 1
+static uint8_t programmed_valid = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Sort
+// Description: This function sorts the order table by deadline (insertion sort, the table
+//              is nearly sorted after every change).
+// Arguments: none
+//
+// Returns: nothing
+static void DS3231_Sched_Sort(void)
+{
+  uint8_t i, j, id;
+  for(i = 1; i < count; i++)
+  {
+    id = order[i];
+    for(j = i; j > 0 && entries[order[j-1]].due > entries[id].due; j--)
+      order[j] = order[j-1];
+    order[j] = id;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Now
+// Description: This function reads the current time in seconds since 2000.
+// Arguments:
+//  - uint32_t* now: pointer to a uint32_t variable to store the current time
+//
+// Returns: see DS3231_ReadDateTime
+static uint8_t DS3231_Sched_Now(uint32_t* now)
+{
+  struct DS3231_DateTime dt;
+  uint8_t ret = DS3231_ReadDateTime(&dt);
+  if(ret == 0)
+    *now = DS3231_DateTimeToSeconds(&dt);
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Program
+// Description: This function programs alarm 1 with the earliest deadline (at most
+//              MAX_ALARM_AHEAD after now, a wake-up without a due alarm only reprograms).
+//              A deadline that is already due is programmed to the next second, so the INT
+//              pin goes low and the next DS3231_Sched_Service runs it. When that second has
+//              passed by the time the alarm is written, the match may have been missed and the
+//              alarm is programmed again. Alarm 1 is only written when the deadline changed.
+// Arguments:
+//  - uint32_t now: the current time (seconds since 2000)
+//
+// Returns:
+//  - 0: if alarm 1 is programmed (or there are no alarms)
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors
+static uint8_t DS3231_Sched_Program(uint32_t now)
+{
+  struct DS3231_DateTime dt;
+  uint32_t due;
+  uint8_t ret;
+
+  if(count == 0)
+    return 0;
+
+  while(1)
+  {
+    due = entries[order[0]].due;
+    if(due > now + MAX_ALARM_AHEAD)
+      due = now + MAX_ALARM_AHEAD;
+    if(due <= now)
+      due = now + 1; // already due, alarm 1 only matches a second that is still to come
+    if(programmed_valid && programmed == due)
+      return 0;
+
+    DS3231_SecondsToDateTime(due, &dt);
+    ret = DS3231_SetAlarm1(dt.seconds, dt.minutes, dt.hours, 255, dt.day_of_month); // match date, hours, minutes and seconds
+    programmed_valid = (ret == 0);
+    programmed = due;
+    if(ret != 0 || due > now + 1)
+      return ret;
+
+    ret = DS3231_Sched_Now(&now); // the next second may have begun while alarm 1 was written
+    if(ret != 0 || now < due)
+      return ret;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Init
+// Description: This function removes all logical alarms and configures the DS3231 so
+//              alarm 1 drives the INT pin (INTCN and A1IE set, pending alarm 1 flag cleared).
+// Arguments: none
+//
+// Returns:
+//  - 0: if the scheduler was succesfully initialized
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Sched_Init(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SCHED_INIT);
+  uint8_t ret;
+
+  count = 0;
+  programmed_valid = 0;
+
+  ret = DS3231_ModifyControl(INTERRUPT_FUNC | ALARM1_INT_ENABLE, INTERRUPT_FUNC | ALARM1_INT_ENABLE);
+  if(ret != 0)
+    return ret;
+  return DS3231_ClearAlarm1Flag();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Add
+// Description: This function adds a logical alarm and reprograms alarm 1 when the new
+//              alarm is the earliest one. A deadline that is not in the future runs on the
+//              next second (alarm 1 is programmed to it).
+// Arguments:
+//  - uint32_t due: first deadline (seconds since 2000, see DS3231_DateTimeToSeconds)
+//  - uint32_t period: period in seconds for a periodic alarm, 0 for a one-shot alarm
+//  - DS3231_SchedCallback callback: called from DS3231_Sched_Service when the alarm is due
+//  - uint8_t* id: pointer to a uint8_t variable to store the id of the alarm (may be 0)
+//
+// Returns:
+//  - 0: if the alarm was succesfully added
+//  - 2: if the table is full or callback is 0
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Sched_Add(uint32_t due, uint32_t period, DS3231_SchedCallback callback, uint8_t* id)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SCHED_ADD);
+  uint8_t i, j, ret;
+  uint32_t now;
+
+  if(count == DS3231_SCHED_MAX || callback == 0)
+    return 2;
+
+  for(i = 0; i < DS3231_SCHED_MAX; i++) // find a free id
+  {
+    for(j = 0; j < count && order[j] != i; j++)
+      ;
+    if(j == count)
+      break;
+  }
+
+  entries[i].due = due;
+  entries[i].period = period;
+  entries[i].callback = callback;
+  order[count++] = i;
+  DS3231_Sched_Sort();
+  if(id != 0)
+    *id = i;
+
+  if(order[0] != i)
+    return 0; // not the earliest deadline, alarm 1 stays as it is
+
+  ret = DS3231_Sched_Now(&now);
+  if(ret != 0)
+    return ret;
+  return DS3231_Sched_Program(now);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_AddIn
+// Description: This function adds a logical alarm that is first due delay seconds from now.
+// Arguments:
+//  - uint32_t delay: number of seconds from now until the first deadline (at least 1)
+//  - uint32_t period, DS3231_SchedCallback callback, uint8_t* id: see DS3231_Sched_Add
+//
+// Returns: see DS3231_Sched_Add
+uint8_t DS3231_Sched_AddIn(uint32_t delay, uint32_t period, DS3231_SchedCallback callback, uint8_t* id)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SCHED_ADD_IN);
+  uint32_t now;
+  uint8_t ret = DS3231_Sched_Now(&now);
+  if(ret != 0)
+    return ret;
+  return DS3231_Sched_Add(now + delay, period, callback, id);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Remove
+// Description: This function removes a logical alarm. Alarm 1 is not reprogrammed, when
+//              the removed alarm was the earliest one the next wake-up only reprograms.
+// Arguments:
+//  - uint8_t id: id of the alarm
+//
+// Returns:
+//  - 0: if the alarm was removed
+//  - 2: if no alarm with this id exists
+uint8_t DS3231_Sched_Remove(uint8_t id)
+{
+  uint8_t i;
+  for(i = 0; i < count && order[i] != id; i++)
+    ;
+  if(i == count)
+    return 2;
+
+  for(; i < count - 1; i++)
+    order[i] = order[i+1];
+  count--;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_NextDue
+// Description: This function returns the earliest deadline.
+// Arguments:
+//  - uint32_t* due: pointer to a uint32_t variable to store the earliest deadline
+//
+// Returns:
+//  - 0: if there is an active alarm
+//  - 2: if there are no alarms
+uint8_t DS3231_Sched_NextDue(uint32_t* due)
+{
+  if(count == 0)
+    return 2;
+  *due = entries[order[0]].due;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sched_Service
+// Description: This function clears the alarm 1 flag (the alarm 2 flag is left to its other
+//              users), runs the callbacks of all alarms that are due and programs alarm 1
+//              with the next deadline. A periodic alarm whose
+//              deadline passed more than one period ago (e.g. during a long operation) runs
+//              once, the skipped periods are reported to its callback and the next deadline
+//              stays on the original grid. When time passes while the callbacks run so that
+//              the next deadline is already due, it is serviced in the same call.
+// Arguments: none
+//
+// Returns:
+//  - 0: if the alarms were succesfully serviced
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Sched_Service(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SCHED_SERVICE);
+  struct SchedEntry* e;
+  uint32_t now, late;
+  uint16_t missed;
+  uint8_t ret, id;
+
+  ret = DS3231_ClearAlarm1Flag();
+  if(ret != 0)
+    return ret;
+  ret = DS3231_Sched_Now(&now);
+  if(ret != 0)
+    return ret;
+
+  while(1)
+  {
+    while(count > 0 && entries[order[0]].due <= now)
+    {
+      id = order[0];
+      e = &entries[id];
+      missed = 0;
+      if(e->period == 0)
+        DS3231_Sched_Remove(id);
+      else
+      {
+        late = (now - e->due) / e->period; // number of whole periods the deadline is late
+        missed = (late > 0xFFFF) ? 0xFFFF : late;
+        e->due += (late + 1) * e->period;
+        DS3231_Sched_Sort();
+      }
+      e->callback(id, missed);
+    }
+
+    programmed_valid = 0; // alarm 1 has fired or may have fired, always program it again
+    ret = DS3231_Sched_Program(now);
+    if(ret != 0)
+      return ret;
+
+    ret = DS3231_Sched_Now(&now);
+    if(ret != 0)
+      return ret;
+    if(count == 0 || entries[order[0]].due > now)
+      return 0; // the programmed deadline is still in the future
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef DS3231_SCHED_HEADER
+#define DS3231_SCHED_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Software alarm scheduler: any number (up to DS3231_SCHED_MAX) of periodic and one-shot
+// alarms multiplexed onto alarm 1 of the DS3231. Alarm 1 is always programmed with the
+// earliest deadline, so the INT pin of the DS3231 only goes low when something is due.
+// Times are seconds since 2000-01-01 00:00:00, see DS3231_DateTimeToSeconds.
+// Usage: call DS3231_Sched_Init once (after DS3231_Init), add alarms and call
+// DS3231_Sched_Service from the main loop when the INT pin is low (or regularly).
+
+#ifndef DS3231_SCHED_MAX
+#define DS3231_SCHED_MAX 16 // maximum number of logical alarms
+#endif
+
+// callback of a logical alarm, missed is the number of periods that were skipped because the
+// deadline was serviced too late (always 0 for one-shot alarms)
+typedef void (*DS3231_SchedCallback)(uint8_t id, uint16_t missed);
+
+// public function prototypes
+uint8_t DS3231_Sched_Init(void);
+uint8_t DS3231_Sched_Add(uint32_t due, uint32_t period, DS3231_SchedCallback callback, uint8_t* id);
+uint8_t DS3231_Sched_AddIn(uint32_t delay, uint32_t period, DS3231_SchedCallback callback, uint8_t* id);
+uint8_t DS3231_Sched_Remove(uint8_t id);
+uint8_t DS3231_Sched_NextDue(uint32_t* due);
+uint8_t DS3231_Sched_Service(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,186 @@
+#include "Gpio.h"
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Sleep.h"
+#include "DS3231_Stats.h"
+
+#define MAX_ALARM_AHEAD (27UL*86400) // alarm 1 matches the day of the month, never program it further ahead than the shortest month
+
+// Hardware hooks, the defaults are for the ATmega328 with the INT pin on INT0 (PD2). Each one
+// can be defined before this file is compiled (e.g. -D) to use another wake-up source or to
+// run the sleep without the avr headers.
+
+// disables / enables interrupts
+#ifndef DS3231_SLEEP_IRQ_OFF
+#include <avr/interrupt.h>
+#define DS3231_SLEEP_IRQ_OFF() cli()
+#endif
+#ifndef DS3231_SLEEP_IRQ_ON
+#include <avr/interrupt.h>
+#define DS3231_SLEEP_IRQ_ON() sei()
+#endif
+
+// enables the wake-up interrupt on a low level of the INT pin / disables it
+#ifndef DS3231_SLEEP_INT0_ARM
+#include <avr/io.h>
+#define DS3231_SLEEP_INT0_ARM() do { EICRA &= ~((1<<ISC01) | (1<<ISC00)); EIMSK |= (1<<INT0); } while(0)
+#endif
+#ifndef DS3231_SLEEP_INT0_DISARM
+#include <avr/io.h>
+#define DS3231_SLEEP_INT0_DISARM() (EIMSK &= ~(1<<INT0))
+#endif
+
+// puts the CPU to sleep, called with interrupts disabled, must return with interrupts enabled
+#ifndef DS3231_SLEEP_CPU
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#define DS3231_SLEEP_CPU() do { set_sleep_mode(SLEEP_MODE_PWR_DOWN); sleep_enable(); sei(); sleep_cpu(); sleep_disable(); } while(0)
+#endif
+
+static volatile uint16_t wake_isr_ticks; // DS3231_TICKS at the INT0 interrupt
+static struct DS3231_WakeInfo wake_info;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sleep_WakeISR
+// Description: This function must be called from ISR(INT0_vect). INT0 is a level
+//              interrupt (the only kind that wakes from power-down) and the INT pin stays low
+//              until the alarm flag is cleared, so INT0 is disabled here
+//              (DS3231_SLEEP_INT0_DISARM).
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Sleep_WakeISR(void)
+{
+  DS3231_SLEEP_INT0_DISARM();
+  wake_isr_ticks = DS3231_TICKS();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SleepUntil
+// Description: This function sleeps in power-down until the given date and time:
+//              - alarm 1 is programmed to match the date, hours, minutes and seconds (for a
+//                wake-up time more than 27 days ahead an intermediate alarm is used and the
+//                function sleeps again)
+//              - INTCN and A1IE are set in the control register, the alarm flags are cleared
+//                before alarm 1 is written (a flag set after that is for the new alarm)
+//              - with interrupts disabled the time is read again, when the alarm time has
+//                already begun (while alarm 1 was written or while the MCU was awake) the
+//                match may have been missed and the MCU does not sleep
+//              - else the MCU sleeps with INT0 (low level) enabled
+//              - after the wake-up the alarm flag is serviced and cleared, when the MCU woke
+//                up before alarm 1 fired (another interrupt) it sleeps again
+//              The software clock is stopped (the INT pin can not output the square wave).
+//              See DS3231_Sleep_GetWakeInfo for the measured wake-up latency.
+// Arguments:
+//  - const struct DS3231_DateTime* pWakeTime: the date and time to wake up
+//
+// Returns:
+//  - 0: if the MCU slept until the wake-up time
+//  - 2: if the wake-up time is not in the future
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_SleepUntil(const struct DS3231_DateTime* pWakeTime)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SLEEP_UNTIL);
+  struct DS3231_DateTime dt;
+  uint32_t target, alarm, now;
+  uint8_t ret, fired;
+
+  DS3231_SoftClock_Stop();
+  target = DS3231_DateTimeToSeconds(pWakeTime);
+  ret = DS3231_ReadDateTime(&dt);
+  if(ret != 0)
+    return ret;
+  now = DS3231_DateTimeToSeconds(&dt);
+  if(target <= now)
+    return 2;
+
+  ret = DS3231_ModifyControl(INTERRUPT_FUNC | ALARM1_INT_ENABLE, INTERRUPT_FUNC | ALARM1_INT_ENABLE);
+  if(ret != 0)
+    return ret;
+  GPIO_PinMode(GPIOD, GPIO_PIN_2, GPIO_INPUT, GPIO_PULLUP); // the INT pin of the DS3231 is open drain
+  wake_info.early_wakeups = 0;
+
+  while(now < target)
+  {
+    alarm = (target - now > MAX_ALARM_AHEAD) ? now + MAX_ALARM_AHEAD : target;
+    DS3231_SecondsToDateTime(alarm, &dt);
+    ret = DS3231_ServiceInterrupt(0); // clear an old alarm flag first, the INT pin goes high
+    if(ret == 0)
+      ret = DS3231_SetAlarm1(dt.seconds, dt.minutes, dt.hours, 255, dt.day_of_month);
+    if(ret != 0)
+      return ret;
+
+    while(1)
+    {
+      DS3231_SLEEP_IRQ_OFF(); // the INT0 interrupt can not disarm INT0 between the time check and the sleep
+      DS3231_SLEEP_INT0_ARM();
+      ret = DS3231_ReadDateTime(&dt);
+      if(ret != 0 || DS3231_DateTimeToSeconds(&dt) >= alarm)
+      {
+        DS3231_SLEEP_INT0_DISARM();
+        wake_isr_ticks = DS3231_TICKS();
+        DS3231_SLEEP_IRQ_ON();
+        if(ret == 0)
+          ret = DS3231_ServiceInterrupt(0); // alarm time reached without a sleep, clear the flag if it was set
+        if(ret != 0)
+          return ret;
+        break;
+      }
+      DS3231_SLEEP_CPU(); // returns after an interrupt, with interrupts enabled
+
+      ret = DS3231_ServiceInterrupt(&fired);
+      if(ret != 0)
+        return ret;
+      if(fired & DS3231_FLAG_A1F)
+        break;
+
+      wake_info.early_wakeups++; // another interrupt woke the MCU
+    }
+
+    ret = DS3231_ReadDateTime(&dt);
+    if(ret != 0)
+      return ret;
+    now = DS3231_DateTimeToSeconds(&dt);
+  }
+
+  wake_info.late_seconds = (int32_t)(now - target);
+  wake_info.wake_ticks = DS3231_TICKS() - wake_isr_ticks;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_SleepFor
+// Description: This function sleeps in power-down for the given number of seconds, see
+//              DS3231_SleepUntil.
+// Arguments:
+//  - uint32_t seconds: number of seconds to sleep (at least 1)
+//
+// Returns: see DS3231_SleepUntil
+uint8_t DS3231_SleepFor(uint32_t seconds)
+{
+  DS3231_STATS_FUNC(DS3231_FN_SLEEP_FOR);
+  struct DS3231_DateTime dt;
+  uint8_t ret;
+
+  DS3231_SoftClock_Stop();
+  ret = DS3231_ReadDateTime(&dt);
+  if(ret != 0)
+    return ret;
+  DS3231_SecondsToDateTime(DS3231_DateTimeToSeconds(&dt) + seconds, &dt);
+  return DS3231_SleepUntil(&dt);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sleep_GetWakeInfo
+// Description: This function returns the information about the last wake-up of
+//              DS3231_SleepUntil / DS3231_SleepFor.
+// Arguments:
+//  - struct DS3231_WakeInfo* pInfo: pointer to a DS3231_WakeInfo struct to store the info
+//
+// Returns: nothing
+void DS3231_Sleep_GetWakeInfo(struct DS3231_WakeInfo* pInfo)
+{
+  *pInfo = wake_info;
+}
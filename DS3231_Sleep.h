@@ -0,0 +1,37 @@
+#ifndef DS3231_SLEEP_HEADER
+#define DS3231_SLEEP_HEADER
+
+#include <stdint.h>
+#include "DS3231.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sleep until an alarm of the DS3231: alarm 1 is programmed, the INT pin of the DS3231 is
+// enabled and the ATmega328 goes to power-down with INT0 (PD2, connected to the INT pin) as
+// wake-up source. The application must call DS3231_Sleep_WakeISR from ISR(INT0_vect).
+// The sleep, the interrupt control and the INT0 setup are macros (DS3231_SLEEP_CPU,
+// DS3231_SLEEP_IRQ_OFF/ON, DS3231_SLEEP_INT0_ARM/DISARM, see DS3231_Sleep.c) that can be
+// defined for another wake-up source or for testing on a host, see also DS3231_TICKS
+// (DS3231_Bus.h).
+
+// information about the last wake-up
+struct DS3231_WakeInfo
+{
+  int32_t late_seconds; // time read after the wake-up minus the requested wake-up time (0 = on time)
+  uint16_t wake_ticks; // DS3231_TICKS from the INT0 interrupt until the flag was serviced and the call returned
+  uint8_t early_wakeups; // number of times the MCU woke up before the alarm fired (other interrupt) and slept again
+};
+
+// public function prototypes
+uint8_t DS3231_SleepUntil(const struct DS3231_DateTime* pWakeTime);
+uint8_t DS3231_SleepFor(uint32_t seconds);
+void DS3231_Sleep_WakeISR(void);
+void DS3231_Sleep_GetWakeInfo(struct DS3231_WakeInfo* pInfo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+#include "DS3231_Stats.h"
+
+#ifdef DS3231_STATS
+#include "DS3231_Bus.h"
+#include <avr/io.h>
+#include <string.h>
+#include <util/atomic.h>
+
+static struct DS3231_Stats stats;
+static uint8_t depth = 0; // number of counted functions on the call stack
+static uint8_t current_fn = DS3231_FN_OTHER; // outermost counted function on the call stack
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Stats_Enter
+// Description: This function opens the scope of a counted call (see DS3231_STATS_FUNC).
+//              Only the outermost counted function is timed and gets the bus usage.
+// Arguments:
+//  - uint8_t fn: function id (DS3231_FN_...)
+//
+// Returns: the scope, passed to DS3231_Stats_Leave when the function returns
+struct DS3231_StatsScope DS3231_Stats_Enter(uint8_t fn)
+{
+  struct DS3231_StatsScope scope;
+  scope.fn = fn;
+  scope.outer = (depth++ == 0);
+  if(scope.outer)
+    current_fn = fn;
+  scope.start = DS3231_TICKS();
+  return scope;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Stats_Leave
+// Description: This function closes the scope of a counted call, it counts the call and
+//              its duration when it was the outermost counted function.
+// Arguments:
+//  - struct DS3231_StatsScope* scope: the scope returned by DS3231_Stats_Enter
+//
+// Returns: nothing
+void DS3231_Stats_Leave(struct DS3231_StatsScope* scope)
+{
+  uint16_t ticks = DS3231_TICKS() - scope->start;
+  uint16_t t = ticks;
+  uint8_t bucket = 0;
+
+  depth--;
+  if(!scope->outer)
+    return;
+  current_fn = DS3231_FN_OTHER;
+
+  while(t > 3 && bucket < DS3231_STATS_BUCKETS - 1)
+  {
+    t >>= 2;
+    bucket++;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // the interrupt driven bus engine updates the same struct
+  {
+    stats.fn[scope->fn].calls++;
+    stats.fn[scope->fn].ticks += ticks;
+    stats.latency[bucket]++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Stats_Current
+// Description: This function returns the outermost counted function on the call stack, the
+//              bus engine tags every queued transaction with it.
+// Arguments: none
+//
+// Returns: the function id, DS3231_FN_OTHER outside of a counted function
+uint8_t DS3231_Stats_Current(void)
+{
+  return current_fn;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Stats_Transaction
+// Description: This function counts a finished (or aborted) bus transaction. Called by the
+//              bus engine, also from the TWI interrupt.
+// Arguments:
+//  - uint8_t fn: function id the transaction was queued by
+//  - uint8_t bytes: number of bytes that were moved over the bus
+//  - uint8_t status: result code of the transaction
+//
+// Returns: nothing
+void DS3231_Stats_Transaction(uint8_t fn, uint8_t bytes, uint8_t status)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    struct DS3231_FuncStats* f = &stats.fn[fn];
+    f->transactions++;
+    f->bytes += bytes;
+    if(status != 0)
+    {
+      f->errors++;
+      if(status == 1)
+        f->timeouts++;
+      else
+        stats.twi_status[status >> 3]++;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Stats_Retry
+// Description: This function counts a retried transaction for the current function.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Stats_Retry(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    stats.fn[current_fn].retries++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Stats_Recovery
+// Description: This function counts a bus recovery for the current function.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Stats_Recovery(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    stats.fn[current_fn].recoveries++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_GetStats
+// Description: This function copies all counters. Interrupts are disabled during the copy
+//              so the counters are a consistent snapshot.
+// Arguments:
+//  - struct DS3231_Stats* pStats: pointer to a DS3231_Stats struct to store the counters
+//
+// Returns: nothing
+void DS3231_GetStats(struct DS3231_Stats* pStats)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    memcpy(pStats, &stats, sizeof(stats));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ResetStats
+// Description: This function resets all counters to zero.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_ResetStats(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    memset(&stats, 0, sizeof(stats));
+  }
+}
+#endif
@@ -0,0 +1,132 @@
+#ifndef DS3231_STATS_HEADER
+#define DS3231_STATS_HEADER
+
+// Performance counters of the DS3231 lib. Compile all files of the lib with DS3231_STATS defined
+// to count, per public function, the calls, the bus transactions and bytes they caused, the
+// failed transactions, retries and bus recoveries and the time spent in the function (measured
+// with DS3231_TICKS, see DS3231_Bus.h). The duration of every call also goes into a histogram
+// with logarithmic buckets, the failed transactions are also counted per TWI status code.
+// Without the define the macros below compile to nothing and the counters cost no flash or RAM.
+// With it they take 980 bytes of RAM. The counters are read with DS3231_GetStats. The host
+// build (host/Makefile, DS3231_TICKS is the simulated microsecond counter) defines DS3231_STATS
+// and host/DS3231_BudgetCheck.c compares them with the bus budget of every function.
+//
+// Bus usage of a function that calls another public function is counted for the outer
+// function only. Counters are 16 bit and wrap, reset them with DS3231_ResetStats.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// function ids, index of struct DS3231_Stats.fn
+#define DS3231_FN_OTHER                 0 // bus use outside of the functions below
+#define DS3231_FN_PUT_IN_KNOWN_STATE    1
+#define DS3231_FN_INIT                  2
+#define DS3231_FN_SET_TIME              3
+#define DS3231_FN_READ_TIME             4
+#define DS3231_FN_SET_DATE              5
+#define DS3231_FN_READ_DATE             6
+#define DS3231_FN_SET_DATE_TIME         7
+#define DS3231_FN_READ_DATE_TIME        8
+#define DS3231_FN_READ_DATE_TIME_ASYNC  9 // the time is the time to queue the read, the transaction is counted on completion
+#define DS3231_FN_SET_EPOCH             10
+#define DS3231_FN_READ_EPOCH            11
+#define DS3231_FN_SET_ALARM1            12
+#define DS3231_FN_READ_ALARM1_FLAG      13
+#define DS3231_FN_CLEAR_ALARM1_FLAG     14
+#define DS3231_FN_SET_ALARM2            15
+#define DS3231_FN_READ_ALARM2_FLAG      16
+#define DS3231_FN_CLEAR_ALARM2_FLAG     17
+#define DS3231_FN_SERVICE_INTERRUPT     18
+#define DS3231_FN_ENABLE_32KHZ_OUTPUT   19
+#define DS3231_FN_MODIFY_CONTROL        20
+#define DS3231_FN_SOFT_CLOCK_START      21
+#define DS3231_FN_SOFT_CLOCK_SERVICE    22
+#define DS3231_FN_TIMESTAMP_START       23
+#define DS3231_FN_SCHED_SERVICE         24
+#define DS3231_FN_DEV_SELECT            25
+#define DS3231_FN_READ_ALL_DATE_TIMES   26
+#define DS3231_FN_START_TEMP_CONVERSION 27
+#define DS3231_FN_POLL_TEMP             28
+#define DS3231_FN_READ_TEMP_AND_STATUS  29
+#define DS3231_FN_READ_AGING_OFFSET     30
+#define DS3231_FN_SET_AGING_OFFSET      31
+#define DS3231_FN_CALIB_START           32
+#define DS3231_FN_SET_DATE_TIME_PRECISE 33
+#define DS3231_FN_RESTORE               34
+#define DS3231_FN_CLEAR_OSF             35
+#define DS3231_FN_LOG_EVENT             36
+#define DS3231_FN_SET_ALARM1_SPEC       37
+#define DS3231_FN_SET_ALARM1_SPEC_P     38
+#define DS3231_FN_SET_ALARM2_SPEC       39
+#define DS3231_FN_SET_ALARM2_SPEC_P     40
+#define DS3231_FN_DEV_READ_DATE_TIME    41
+#define DS3231_FN_DEV_SET_DATE_TIME     42
+#define DS3231_FN_CALIB_SERVICE         43
+#define DS3231_FN_CALIB_MARK            44 // no bus use, a call from an interrupt during another counted function is not counted
+#define DS3231_FN_SLEEP_UNTIL           45 // the time includes the sleep (16 bit ticks per call, longer sleeps wrap)
+#define DS3231_FN_SLEEP_FOR             46 // see DS3231_FN_SLEEP_UNTIL
+#define DS3231_FN_SCHED_INIT            47
+#define DS3231_FN_SCHED_ADD             48
+#define DS3231_FN_SCHED_ADD_IN          49
+#define DS3231_FN_COUNT                 50
+
+#define DS3231_STATS_BUCKETS 8 // bucket i counts the calls that took less than 4^(i+1) ticks (the last one all longer calls)
+
+// counters of one public function
+struct DS3231_FuncStats
+{
+  uint16_t calls; // number of calls
+  uint16_t transactions; // number of bus transactions (one per start ... stop, retries included)
+  uint16_t bytes; // number of bytes on the wire (address, register pointer and data bytes)
+  uint16_t errors; // number of transactions that failed (timeouts included)
+  uint16_t timeouts; // number of transactions that timed out or ended with a bus error
+  uint16_t retries; // number of retried transactions
+  uint16_t recoveries; // number of bus recoveries
+  uint32_t ticks; // total time spent in the function in DS3231_TICKS
+};
+
+// all counters, see DS3231_GetStats
+struct DS3231_Stats
+{
+  struct DS3231_FuncStats fn[DS3231_FN_COUNT]; // per function, indexed by DS3231_FN_...
+  uint16_t latency[DS3231_STATS_BUCKETS]; // duration of all calls, see DS3231_STATS_BUCKETS
+  uint16_t twi_status[32]; // failed transactions per TWI status code, index = code >> 3 (timeouts are not included)
+};
+
+#ifdef DS3231_STATS
+// scope of a counted call, created by DS3231_STATS_FUNC and closed automatically when the
+// function returns (cleanup attribute, as used by ATOMIC_BLOCK)
+struct DS3231_StatsScope
+{
+  uint8_t fn; // function id
+  uint8_t outer; // 1 if this is not a call from within another counted function
+  uint16_t start; // DS3231_TICKS on entry
+};
+
+struct DS3231_StatsScope DS3231_Stats_Enter(uint8_t fn);
+void DS3231_Stats_Leave(struct DS3231_StatsScope* scope);
+uint8_t DS3231_Stats_Current(void);
+void DS3231_Stats_Transaction(uint8_t fn, uint8_t bytes, uint8_t status);
+void DS3231_Stats_Retry(void);
+void DS3231_Stats_Recovery(void);
+void DS3231_GetStats(struct DS3231_Stats* pStats);
+void DS3231_ResetStats(void);
+#define DS3231_STATS_FUNC(fn) struct DS3231_StatsScope ds3231_stats_scope __attribute__((cleanup(DS3231_Stats_Leave))) = DS3231_Stats_Enter(fn)
+#define DS3231_STATS_TRANSACTION(fn, bytes, status) DS3231_Stats_Transaction((fn), (bytes), (status))
+#define DS3231_STATS_RETRY() DS3231_Stats_Retry()
+#define DS3231_STATS_RECOVERY() DS3231_Stats_Recovery()
+#else
+#define DS3231_STATS_FUNC(fn) ((void)0)
+#define DS3231_STATS_TRANSACTION(fn, bytes, status) ((void)0)
+#define DS3231_STATS_RETRY() ((void)0)
+#define DS3231_STATS_RECOVERY() ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
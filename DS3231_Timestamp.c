@@ -0,0 +1,132 @@
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Stats.h"
+#include "DS3231_Bcd.h"
+#include "DS3231_Timestamp.h"
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#define SYNC_MAX_POLLS 5000 // maximum number of seconds register reads while waiting for a second boundary
+
+static uint32_t base_seconds; // seconds of the day at the second boundary on which Timer1 was started
+static volatile uint32_t overflows; // number of Timer1 overflows since the start, one overflow = 2 seconds
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Timestamp_Start
+// Description: This function enables the 32kHz output of the DS3231 and synchronizes
+//              Timer1 (counting the 32kHz output on T1) with a second boundary of the DS3231.
+//              To find the boundary the seconds register is polled until it changes, the
+//              uncertainty of the alignment is the duration of one poll (a 3 byte burst read,
+//              about 0.7 ms at 100 kHz). This is the only bus traffic, DS3231_ReadTimestamp
+//              does not use the bus.
+// Arguments: none
+//
+// Returns:
+//  - 0: if the timestamp counter was succesfully started
+//  - 2: if the seconds did not change (oscillator of the DS3231 stopped)
+//  - 1: if a timeout error occured in the TWI driver
+//  - else: other codes represent specific TWI status errors, see TWI chapter in
+//          ATmega328 datasheet for the meaning of the code
+uint8_t DS3231_Timestamp_Start(void)
+{
+  DS3231_STATS_FUNC(DS3231_FN_TIMESTAMP_START);
+  uint8_t ret, first, buf[3];
+  uint16_t polls;
+
+  ret = DS3231_Enable32kHzOutput(1);
+  if(ret != 0)
+    return ret;
+
+  TCCR1B = 0; // stop Timer1
+  TCCR1A = 0; // normal mode
+  TIMSK1 = 0;
+
+  ret = DS3231_Bus_Read(SECONDS_ADDRESS, &buf[0], 1);
+  if(ret != 0)
+    return ret;
+  first = buf[0];
+
+  for(polls = 0; polls < SYNC_MAX_POLLS; polls++)
+  {
+    ret = DS3231_Bus_Read(SECONDS_ADDRESS, buf, 3);
+    if(ret != 0)
+      return ret;
+    if(buf[0] != first) // second boundary
+    {
+      TCNT1 = 0;
+      TCCR1B = (1<<CS12) | (1<<CS11) | (1<<CS10); // external clock on T1, rising edge
+      break;
+    }
+  }
+  if(polls == SYNC_MAX_POLLS)
+    return 2;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    overflows = 0;
+    base_seconds = (uint32_t)DS3231_DecodeBCD(buf[2] & DS3231_BCD_MASK_HOURS) * 3600 +
+                   (uint16_t)DS3231_DecodeBCD(buf[1] & DS3231_BCD_MASK_MINUTES) * 60 +
+                   DS3231_DecodeBCD(buf[0] & DS3231_BCD_MASK_SECONDS);
+    TIFR1 = (1<<TOV1); // clear a pending overflow
+    TIMSK1 = (1<<TOIE1); // enable the overflow interrupt
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Timestamp_Stop
+// Description: This function stops Timer1, the 32kHz output of the DS3231 is left enabled.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Timestamp_Stop(void)
+{
+  TCCR1B = 0;
+  TIMSK1 = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Timestamp_OverflowISR
+// Description: This function counts the overflows of Timer1, it must be called from
+//              ISR(TIMER1_OVF_vect).
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Timestamp_OverflowISR(void)
+{
+  overflows++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_ReadTimestamp
+// Description: This function returns a high resolution timestamp without bus traffic.
+//              Timer1 counts 32768 pulses per second of the DS3231, so a full 16 bit period
+//              is exactly 2 seconds: the seconds follow from the overflow count and bit 15 of
+//              the counter, the sub-second part from bits 14..0. Because the seconds are
+//              derived from the counter itself a second boundary can not tear the timestamp.
+//              An overflow that happened just before the capture but is not yet counted by
+//              the interrupt (TOV1 still set) is taken into account.
+// Arguments:
+//  - uint32_t* seconds: pointer to a uint32_t variable to store the seconds, counted from
+//                       midnight of the day on which DS3231_Timestamp_Start was called (keeps
+//                       counting past midnight)
+//  - uint16_t* subsec: pointer to a uint16_t variable to store the fraction of the second in
+//                      units of 1/32768 s (0 to 32767)
+//
+// Returns: nothing
+void DS3231_ReadTimestamp(uint32_t* seconds, uint16_t* subsec)
+{
+  uint16_t cnt;
+  uint32_t ovf;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    cnt = TCNT1;
+    ovf = overflows;
+    if((TIFR1 & (1<<TOV1)) && cnt < 0x8000) // overflow pending and the counter value is from after it
+      ovf++;
+  }
+
+  *seconds = base_seconds + (ovf<<1) + (cnt>>15);
+  *subsec = cnt & 0x7FFF;
+}
@@ -0,0 +1,27 @@
+#ifndef DS3231_TIMESTAMP_HEADER
+#define DS3231_TIMESTAMP_HEADER
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sub-second timestamps from the 32.768 kHz output of the DS3231.
+// Hardware: the 32kHz pin of the DS3231 must be connected to the T1 pin (PD5) of the
+// ATmega328, Timer1 is used as a counter clocked by this pin. The application must call
+// DS3231_Timestamp_OverflowISR from ISR(TIMER1_OVF_vect).
+
+#define DS3231_SUBSEC_PER_SECOND 32768 // resolution of the subsec value (about 30.5 us per step)
+
+// public function prototypes
+uint8_t DS3231_Timestamp_Start(void);
+void DS3231_Timestamp_Stop(void);
+void DS3231_Timestamp_OverflowISR(void);
+void DS3231_ReadTimestamp(uint32_t* seconds, uint16_t* subsec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
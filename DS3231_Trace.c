@@ -0,0 +1,59 @@
+#include "DS3231_Trace.h"
+
+#ifdef DS3231_TRACE
+#include <util/atomic.h>
+
+static struct DS3231_TraceEvent trace_buf[DS3231_TRACE_SIZE]; // ring buffer, oldest events are overwritten
+static uint8_t trace_head = 0; // index of the oldest event
+static uint8_t trace_count = 0; // number of events in the buffer
+static uint8_t trace_seq = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Trace_Record
+// Description: This function records an event in the ring buffer, when the buffer is full
+//              the oldest event is overwritten. Can be called from interrupts.
+// Arguments:
+//  - uint8_t id: event id (DS3231_EV_...)
+//  - uint8_t reg: register address
+//  - uint8_t status: result code or value
+//
+// Returns: nothing
+void DS3231_Trace_Record(uint8_t id, uint8_t reg, uint8_t status)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    struct DS3231_TraceEvent* ev = &trace_buf[(trace_head + trace_count) % DS3231_TRACE_SIZE];
+    ev->id = id;
+    ev->reg = reg;
+    ev->status = status;
+    ev->seq = trace_seq++;
+    if(trace_count < DS3231_TRACE_SIZE)
+      trace_count++;
+    else
+      trace_head = (trace_head + 1) % DS3231_TRACE_SIZE; // overwrote the oldest event
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Trace_Read
+// Description: This function moves the oldest events out of the ring buffer.
+// Arguments:
+//  - struct DS3231_TraceEvent* out: array that receives the events
+//  - uint8_t max: size of the out array
+//
+// Returns: the number of events copied to out
+uint8_t DS3231_Trace_Read(struct DS3231_TraceEvent* out, uint8_t max)
+{
+  uint8_t n = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    while(n < max && trace_count > 0)
+    {
+      out[n++] = trace_buf[trace_head];
+      trace_head = (trace_head + 1) % DS3231_TRACE_SIZE;
+      trace_count--;
+    }
+  }
+  return n;
+}
+#endif
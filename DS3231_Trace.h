@@ -0,0 +1,51 @@
+#ifndef DS3231_TRACE_HEADER
+#define DS3231_TRACE_HEADER
+
+// Binary trace of the DS3231 lib. Compile all files of the lib with DS3231_TRACE defined to
+// record compact events in a RAM ring buffer, without the define DS3231_TRACE_EVENT compiles to
+// nothing and the trace costs no flash or RAM. The events can be copied out with
+// DS3231_Trace_Read, sent as raw bytes (e.g. over the USART) and turned into a readable log with
+// tools/DS3231_TraceDecode.c.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef DS3231_TRACE_SIZE
+#define DS3231_TRACE_SIZE 32 // number of events in the ring buffer (4 bytes each)
+#endif
+
+// event ids, keep tools/DS3231_TraceDecode.c in sync
+#define DS3231_EV_INIT       1 // DS3231_Init wrote the control register, reg = CTRL_ADDRESS, status = written value
+#define DS3231_EV_READ       2 // a bus read finished, reg = first register, status = result code
+#define DS3231_EV_WRITE      3 // a bus write finished, reg = first register, status = result code
+#define DS3231_EV_ABORT      4 // bus operations were aborted (timeout: the active one, failed recovery: all), reg = 0, status = number of aborted operations
+#define DS3231_EV_BUS_INIT   5 // DS3231_Bus_Init, reg = TWBR, status = 0 or 2 (speed not achievable)
+#define DS3231_EV_SOFT_DRIFT 6 // the software clock was corrected on a resync, reg = 0, status = drift in seconds (int8, clamped)
+#define DS3231_EV_RECOVER    7 // DS3231_Bus_Recover, reg = number of SCL pulses, status = 0 or 1 (bus still stuck)
+#define DS3231_EV_RETRY      8 // a blocking bus operation is retried, reg = first register, status = result code of the failed attempt
+
+// one recorded event
+struct DS3231_TraceEvent
+{
+  uint8_t id; // event id, see above
+  uint8_t reg; // register address (meaning depends on the event)
+  uint8_t status; // result code or value (meaning depends on the event)
+  uint8_t seq; // sequence number, increments with every recorded event (shows lost events)
+};
+
+#ifdef DS3231_TRACE
+void DS3231_Trace_Record(uint8_t id, uint8_t reg, uint8_t status);
+uint8_t DS3231_Trace_Read(struct DS3231_TraceEvent* out, uint8_t max);
+#define DS3231_TRACE_EVENT(id, reg, status) DS3231_Trace_Record((id), (reg), (status))
+#else
+#define DS3231_TRACE_EVENT(id, reg, status) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
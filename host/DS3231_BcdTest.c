@@ -0,0 +1,56 @@
+// Exhaustive check of the BCD kernels of DS3231_Bcd.h against the division based arithmetic:
+// every value 0 to 99, every valid BCD byte, every year 0 to 199 through the block functions
+// (also in place). Exits with 1 if a check failed.
+
+#include "DS3231_Bcd.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK(cond) do { checks++; if(!(cond)) { failed++; if(failed <= 10) printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while(0)
+
+static unsigned long checks, failed;
+
+int main(void)
+{
+  unsigned v, i;
+
+  for(v = 0; v <= 99; v++)
+  {
+    uint8_t bcd = (uint8_t)(((v / 10) << 4) | (v % 10));
+    CHECK(DS3231_EncodeBCD((uint8_t)v) == bcd);
+    CHECK(DS3231_DecodeBCD(bcd) == v);
+  }
+
+  // a timekeeping block per year, the other fields cycle through their ranges
+  for(v = 0; v <= 199; v++)
+  {
+    uint8_t in[7], raw[7], out[7], same[7];
+    in[0] = (uint8_t)(v % 60);
+    in[1] = (uint8_t)((v * 7) % 60);
+    in[2] = (uint8_t)(v % 24);
+    in[3] = (uint8_t)(v % 7 + 1);
+    in[4] = (uint8_t)(v % 31 + 1);
+    in[5] = (uint8_t)(v % 12 + 1);
+    in[6] = (uint8_t)v;
+
+    DS3231_EncodeBCDBlock(in, raw);
+    for(i = 0; i < 6; i++)
+      CHECK((raw[i] & ~(i == 5 ? DS3231_BCD_CENTURY : 0)) == (((in[i] / 10) << 4) | (in[i] % 10)));
+    CHECK(raw[6] == (((v % 100) / 10) << 4 | (v % 10)));
+    CHECK(((raw[5] & DS3231_BCD_CENTURY) != 0) == (v >= 100));
+
+    raw[0] |= 0x80; // flag bits outside the masks are ignored
+    raw[2] |= 0x40;
+    raw[3] |= 0xF8;
+    DS3231_DecodeBCDBlock(raw, out);
+    CHECK(memcmp(in, out, 7) == 0);
+
+    memcpy(same, in, 7);
+    DS3231_EncodeBCDBlock(same, same);
+    DS3231_DecodeBCDBlock(same, same);
+    CHECK(memcmp(in, same, 7) == 0);
+  }
+
+  printf("%lu checks, %lu failed\n", checks, failed);
+  return failed != 0;
+}
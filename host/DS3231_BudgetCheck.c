@@ -0,0 +1,312 @@
+// Checks the bus budget of the README against the simulated DS3231: every function of the table
+// is called once (successfully, in the state the table assumes: shadows loaded by
+// DS3231_Restore, software clock stopped) and its start conditions, bytes and estimated bus
+// times (DS3231_Bus_GetCost, DS3231_Bus_EstimateTime_us) are compared with its row. Exits with
+// 1 when a function exceeds its budget, fails, or a function and its row do not match up.
+// The host build defines DS3231_STATS: the transactions and bytes DS3231_GetStats counted for
+// the function must equal the bus cost (all of it under the function's DS3231_FN_ id), the
+// simulated duration of the call (DS3231_TICKS, 1 us per tick) is printed.
+// Usage: DS3231_BudgetCheck [README.md]
+
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Calib.h"
+#include "DS3231_Log.h"
+#include "DS3231_Multi.h"
+#include "DS3231_Sched.h"
+#include "DS3231_Sleep.h"
+#include "DS3231_Sim.h"
+#include "DS3231_Stats.h"
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_ROWS 64
+
+// a row of the budget table
+struct Row
+{
+  char name[40];
+  unsigned starts, bytes, us100, us400;
+  int used;
+};
+
+// a measured call: prepare sets up the state (may use the bus), call is measured
+struct Entry
+{
+  const char* row; // name in the budget table
+  const char* call_name;
+  void (*prepare)(void);
+  uint8_t (*call)(void);
+  uint8_t fn; // DS3231_FN_... the call is counted under, DS3231_FN_OTHER if it is not counted
+};
+
+static struct Row rows[MAX_ROWS];
+static unsigned row_count;
+
+static const struct DS3231_Alarm1Spec alarm1_spec = DS3231_ALARM1_SPEC(PER_DAY, 0, 30, 6, 0);
+static const struct DS3231_Alarm2Spec alarm2_spec = DS3231_ALARM2_SPEC(PER_DAY, 30, 6, 0);
+static const struct DS3231_Alarm1Spec alarm1_spec_P PROGMEM = DS3231_ALARM1_SPEC(PER_DAY, 0, 30, 6, 0);
+static const struct DS3231_Alarm2Spec alarm2_spec_P PROGMEM = DS3231_ALARM2_SPEC(PER_DAY, 30, 6, 0);
+static const struct DS3231_DateTime date_time = {0, 30, 12, WEDNESDAY, 15, 6, 24};
+static struct DS3231_Init_Struct init_struct = {ENABLE_OSC, INTERRUPT_FUNC, BBSW_DISABLE, SWFREQ_1HZ, ALARM1_INT_DISABLE, ALARM2_INT_DISABLE, 0, 0};
+static const struct DS3231_DateTime wake_time = {2, 0, 0, SATURDAY, 1, 1, 0}; // 2 s after DS3231_Sim_Reset
+static struct DS3231_Dev devs[2]; // behind channel 0 of mux 0 and channel 1 of mux 1
+
+// powered DS3231 with a valid time, lib after DS3231_Restore and DS3231_Init
+static void Boot(void)
+{
+  DS3231_Sim_Reset();
+  DS3231_Sim_WriteRegister(STATUS_ADDRESS, 0x08); // OSF clear
+  DS3231_SoftClock_Stop();
+  DS3231_InvalidateCache();
+  DS3231_Restore(0);
+  DS3231_Init(&init_struct);
+}
+
+static void Boot_Invalid(void) { Boot(); DS3231_InvalidateCache(); }
+static void Boot_Alarm1Fired(void) { Boot(); DS3231_Sim_WriteRegister(STATUS_ADDRESS, 0x09); }
+static void Boot_Converted(void) { Boot(); DS3231_StartTempConversion(); DS3231_Sim_Advance_us(200000); }
+static void Boot_Log(void) { Boot(); DS3231_Log_Init(); }
+static void Boot_SoftClock(void) { Boot(); DS3231_SoftClock_Start(1); DS3231_Sim_Advance_us(1000000); DS3231_SoftClock_Tick(); }
+static void Boot_Sched(void) { Boot(); DS3231_Sched_Init(); }
+
+// devs[0] selected, whatever DS3231_Multi.c assumes from the previous entry
+static void Boot_Dev(void)
+{
+  Boot();
+  DS3231_Sim_AddMux(0);
+  DS3231_Sim_AddMux(1);
+  DS3231_Dev_Select(&devs[1]);
+  DS3231_Dev_Select(&devs[0]);
+}
+
+static void Sched_Callback(uint8_t id, uint16_t missed) { (void)id; (void)missed; }
+
+static uint8_t Call_PutInKnownI2CState(void) { return DS3231_PutInKnownI2CState(); }
+static uint8_t Call_Init(void)
+{
+  struct DS3231_Init_Struct s = init_struct;
+  s.Alarm1InterruptEnable = ALARM1_INT_ENABLE; // another configuration, so the register is written
+  return DS3231_Init(&s);
+}
+static uint8_t Call_Restore(void) { struct DS3231_DateTime dt; return DS3231_Restore(&dt); }
+static uint8_t Call_ClearOscillatorStopFlag(void) { return DS3231_ClearOscillatorStopFlag(); }
+static uint8_t Call_SetTime(void) { return DS3231_SetTime(1, 2, 3); }
+static uint8_t Call_ReadTime(void) { uint8_t s, m, h; return DS3231_ReadTime(&s, &m, &h); }
+static uint8_t Call_SetDate(void) { return DS3231_SetDate(15, 6, 24); }
+static uint8_t Call_ReadDate(void) { uint8_t d, m, y; return DS3231_ReadDate(&d, &m, &y); }
+static uint8_t Call_SetDateTime(void) { return DS3231_SetDateTime(&date_time); }
+static uint8_t Call_ReadDateTime(void) { struct DS3231_DateTime dt; return DS3231_ReadDateTime(&dt); }
+static uint8_t Call_SetDateTimePrecise(void) { return DS3231_SetDateTimePrecise(&date_time, 250, 0); }
+static uint8_t Call_SetEpoch(void) { return DS3231_SetEpoch(DS3231_EPOCH_2000 + 86400UL*1000); }
+static uint8_t Call_ReadEpoch(void) { uint32_t e; return DS3231_ReadEpoch(&e); }
+static uint8_t Call_SetAlarm1(void) { return DS3231_SetAlarm1(0, 30, 6, 255, 255); }
+static uint8_t Call_SetAlarm2(void) { return DS3231_SetAlarm2(30, 6, 255, 255); }
+static uint8_t Call_SetAlarm1Spec(void) { return DS3231_SetAlarm1Spec(&alarm1_spec); }
+static uint8_t Call_SetAlarm1Spec_P(void) { return DS3231_SetAlarm1Spec_P(&alarm1_spec_P); }
+static uint8_t Call_SetAlarm2Spec(void) { return DS3231_SetAlarm2Spec(&alarm2_spec); }
+static uint8_t Call_SetAlarm2Spec_P(void) { return DS3231_SetAlarm2Spec_P(&alarm2_spec_P); }
+static uint8_t Call_Dev_Select(void) { return DS3231_Dev_Select(&devs[1]); }
+static uint8_t Call_Dev_ReadDateTime(void) { struct DS3231_DateTime dt; return DS3231_Dev_ReadDateTime(&devs[0], &dt); }
+static uint8_t Call_Dev_SetDateTime(void) { return DS3231_Dev_SetDateTime(&devs[0], &date_time); }
+static uint8_t Call_ReadAllDateTimes(void) { struct DS3231_DateTime dt[2]; return DS3231_ReadAllDateTimes(devs, 2, dt); }
+static uint8_t Call_ReadAlarm1Flag(void) { return DS3231_ReadAlarm1Flag() > 1; } // returns the flag
+static uint8_t Call_ClearAlarm1Flag(void) { return DS3231_ClearAlarm1Flag(); }
+static uint8_t Call_ReadAlarm2Flag(void) { return DS3231_ReadAlarm2Flag() > 1; }
+static uint8_t Call_ClearAlarm2Flag(void) { return DS3231_ClearAlarm2Flag(); }
+static uint8_t Call_ServiceInterrupt(void) { uint8_t f; return DS3231_ServiceInterrupt(&f); }
+static uint8_t Call_Enable32kHzOutput(void) { return DS3231_Enable32kHzOutput(0); }
+static uint8_t Call_SoftClock_Start(void) { return DS3231_SoftClock_Start(60); }
+static uint8_t Call_ModifyControl(void) { return DS3231_ModifyControl(ALARM2_INT_ENABLE, ALARM2_INT_ENABLE); }
+static uint8_t Call_InvalidateCache(void) { DS3231_InvalidateCache(); return 0; }
+static uint8_t Call_StartTempConversion(void) { return DS3231_StartTempConversion(); }
+static uint8_t Call_PollTemp(void) { int16_t t; return DS3231_PollTemp(&t); }
+static uint8_t Call_ReadTempAndStatus(void) { int16_t t; uint8_t s; return DS3231_ReadTempAndStatus(&t, &s); }
+static uint8_t Call_ReadAgingOffset(void) { int8_t a; return DS3231_ReadAgingOffset(&a); }
+static uint8_t Call_SetAgingOffset(void) { return DS3231_SetAgingOffset(3); }
+static uint8_t Call_Calib_Start(void) { return DS3231_Calib_Start(0); }
+static uint8_t Call_Calib_Mark(void) { DS3231_Calib_Mark(0); return 0; }
+static uint8_t Call_Calib_Service(void) { return DS3231_Calib_Service(); } // without a new event
+static uint8_t Call_SleepUntil(void) { return DS3231_SleepUntil(&wake_time); }
+static uint8_t Call_SleepFor(void) { return DS3231_SleepFor(2); }
+static uint8_t Call_Sched_Init(void) { return DS3231_Sched_Init(); }
+static uint8_t Call_Sched_Add(void) { return DS3231_Sched_Add(5, 0, Sched_Callback, 0); }
+static uint8_t Call_Sched_AddIn(void) { return DS3231_Sched_AddIn(5, 0, Sched_Callback, 0); }
+static uint8_t Call_Log_Event(void) { return DS3231_Log_Event(1); }
+static uint8_t Call_SoftClock_Service(void) { return DS3231_SoftClock_Service(); }
+
+#define ENTRY(row, prepare, fn, id) { row, #fn, prepare, Call_##fn, id }
+
+static const struct Entry entries[] =
+{
+  ENTRY("DS3231_PutInKnownI2CState", DS3231_Sim_Reset, PutInKnownI2CState, DS3231_FN_PUT_IN_KNOWN_STATE),
+  ENTRY("DS3231_Init", Boot, Init, DS3231_FN_INIT),
+  ENTRY("DS3231_Restore", Boot_Invalid, Restore, DS3231_FN_RESTORE),
+  ENTRY("DS3231_ClearOscillatorStopFlag", Boot, ClearOscillatorStopFlag, DS3231_FN_CLEAR_OSF),
+  ENTRY("DS3231_SetTime", Boot, SetTime, DS3231_FN_SET_TIME),
+  ENTRY("DS3231_ReadTime", Boot, ReadTime, DS3231_FN_READ_TIME),
+  ENTRY("DS3231_SetDate", Boot, SetDate, DS3231_FN_SET_DATE),
+  ENTRY("DS3231_ReadDate", Boot, ReadDate, DS3231_FN_READ_DATE),
+  ENTRY("DS3231_SetDateTime", Boot, SetDateTime, DS3231_FN_SET_DATE_TIME),
+  ENTRY("DS3231_ReadDateTime", Boot, ReadDateTime, DS3231_FN_READ_DATE_TIME),
+  ENTRY("DS3231_SetDateTimePrecise", Boot, SetDateTimePrecise, DS3231_FN_SET_DATE_TIME_PRECISE),
+  ENTRY("DS3231_SetEpoch", Boot, SetEpoch, DS3231_FN_SET_EPOCH),
+  ENTRY("DS3231_ReadEpoch", Boot, ReadEpoch, DS3231_FN_READ_EPOCH),
+  ENTRY("DS3231_SetAlarm1", Boot, SetAlarm1, DS3231_FN_SET_ALARM1),
+  ENTRY("DS3231_SetAlarm2", Boot, SetAlarm2, DS3231_FN_SET_ALARM2),
+  ENTRY("DS3231_SetAlarm1Spec", Boot, SetAlarm1Spec, DS3231_FN_SET_ALARM1_SPEC),
+  ENTRY("DS3231_SetAlarm1Spec_P", Boot, SetAlarm1Spec_P, DS3231_FN_SET_ALARM1_SPEC_P),
+  ENTRY("DS3231_SetAlarm2Spec", Boot, SetAlarm2Spec, DS3231_FN_SET_ALARM2_SPEC),
+  ENTRY("DS3231_SetAlarm2Spec_P", Boot, SetAlarm2Spec_P, DS3231_FN_SET_ALARM2_SPEC_P),
+  ENTRY("DS3231_ReadAlarm1Flag", Boot, ReadAlarm1Flag, DS3231_FN_READ_ALARM1_FLAG),
+  ENTRY("DS3231_ClearAlarm1Flag", Boot, ClearAlarm1Flag, DS3231_FN_CLEAR_ALARM1_FLAG),
+  ENTRY("DS3231_ReadAlarm2Flag", Boot, ReadAlarm2Flag, DS3231_FN_READ_ALARM2_FLAG),
+  ENTRY("DS3231_ClearAlarm2Flag", Boot, ClearAlarm2Flag, DS3231_FN_CLEAR_ALARM2_FLAG),
+  ENTRY("DS3231_ServiceInterrupt", Boot_Alarm1Fired, ServiceInterrupt, DS3231_FN_SERVICE_INTERRUPT),
+  ENTRY("DS3231_Enable32kHzOutput", Boot, Enable32kHzOutput, DS3231_FN_ENABLE_32KHZ_OUTPUT),
+  ENTRY("DS3231_SoftClock_Start", Boot, SoftClock_Start, DS3231_FN_SOFT_CLOCK_START),
+  ENTRY("DS3231_ModifyControl", Boot, ModifyControl, DS3231_FN_MODIFY_CONTROL),
+  ENTRY("DS3231_InvalidateCache", Boot, InvalidateCache, DS3231_FN_OTHER),
+  ENTRY("DS3231_StartTempConversion", Boot, StartTempConversion, DS3231_FN_START_TEMP_CONVERSION),
+  ENTRY("DS3231_PollTemp", Boot_Converted, PollTemp, DS3231_FN_POLL_TEMP),
+  ENTRY("DS3231_ReadTempAndStatus", Boot, ReadTempAndStatus, DS3231_FN_READ_TEMP_AND_STATUS),
+  ENTRY("DS3231_ReadAgingOffset", Boot, ReadAgingOffset, DS3231_FN_READ_AGING_OFFSET),
+  ENTRY("DS3231_SetAgingOffset", Boot, SetAgingOffset, DS3231_FN_SET_AGING_OFFSET),
+  ENTRY("DS3231_Calib_Start", Boot, Calib_Start, DS3231_FN_CALIB_START),
+  ENTRY("DS3231_Calib_Mark", Boot, Calib_Mark, DS3231_FN_CALIB_MARK),
+  ENTRY("DS3231_Calib_Service", Boot, Calib_Service, DS3231_FN_CALIB_SERVICE),
+  ENTRY("DS3231_Log_Event", Boot_Log, Log_Event, DS3231_FN_LOG_EVENT),
+  ENTRY("DS3231_SoftClock_Service", Boot_SoftClock, SoftClock_Service, DS3231_FN_SOFT_CLOCK_SERVICE),
+  ENTRY("DS3231_SleepUntil", Boot, SleepUntil, DS3231_FN_SLEEP_UNTIL),
+  ENTRY("DS3231_SleepFor", Boot, SleepFor, DS3231_FN_SLEEP_FOR),
+  ENTRY("DS3231_Sched_Init", Boot, Sched_Init, DS3231_FN_SCHED_INIT),
+  ENTRY("DS3231_Sched_Add", Boot_Sched, Sched_Add, DS3231_FN_SCHED_ADD),
+  ENTRY("DS3231_Sched_AddIn", Boot_Sched, Sched_AddIn, DS3231_FN_SCHED_ADD_IN),
+  ENTRY("DS3231_Dev_Select", Boot_Dev, Dev_Select, DS3231_FN_DEV_SELECT),
+  ENTRY("DS3231_Dev_ReadDateTime", Boot_Dev, Dev_ReadDateTime, DS3231_FN_DEV_READ_DATE_TIME),
+  ENTRY("DS3231_Dev_SetDateTime", Boot_Dev, Dev_SetDateTime, DS3231_FN_DEV_SET_DATE_TIME),
+  ENTRY("DS3231_ReadAllDateTimes", Boot_Dev, ReadAllDateTimes, DS3231_FN_READ_ALL_DATE_TIMES),
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Read_Budget
+// Description: This function reads the rows of the budget table ("| DS3231_... | starts |
+//              bytes | us | us |") from the README.
+// Arguments:
+//  - const char* path: path of the README
+//
+// Returns: 0 if at least one row was read, else 1
+static int Read_Budget(const char* path)
+{
+  char line[256];
+  FILE* f = fopen(path, "r");
+
+  if(f == 0)
+  {
+    perror(path);
+    return 1;
+  }
+  while(fgets(line, sizeof(line), f) != 0 && row_count < MAX_ROWS)
+  {
+    struct Row* r = &rows[row_count];
+    if(sscanf(line, "| %39s | %u | %u | %u | %u |", r->name, &r->starts, &r->bytes, &r->us100, &r->us400) == 5 &&
+       strncmp(r->name, "DS3231_", 7) == 0)
+      row_count++;
+  }
+  fclose(f);
+  if(row_count == 0)
+    fprintf(stderr, "%s: no budget table found\n", path);
+  return row_count == 0;
+}
+
+static struct Row* Find_Row(const char* name)
+{
+  unsigned i;
+  for(i = 0; i < row_count; i++)
+  {
+    if(strcmp(rows[i].name, name) == 0)
+      return &rows[i];
+  }
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned i, errors = 0;
+
+  if(Read_Budget((argc > 1) ? argv[1] : "../README.md") != 0)
+    return 1;
+  if(DS3231_Dev_Init(&devs[0], DS3231_MUX_ADDRESS(0), 0) != 0 || DS3231_Dev_Init(&devs[1], DS3231_MUX_ADDRESS(1), 1) != 0)
+    return 1;
+
+  printf("%-34s %13s %13s %15s %15s %8s\n", "function", "starts", "bytes", "us @ 100 kHz", "us @ 400 kHz", "sim us");
+  for(i = 0; i < sizeof(entries)/sizeof(entries[0]); i++)
+  {
+    const struct Entry* e = &entries[i];
+    struct Row* r = Find_Row(e->row);
+    struct DS3231_BusCost cost;
+    struct DS3231_Stats stats;
+    uint32_t us100, us400;
+    unsigned transactions = 0, bytes = 0, fn;
+    uint8_t ret;
+
+    e->prepare();
+    DS3231_Bus_ResetCost();
+    DS3231_ResetStats();
+    ret = e->call();
+    DS3231_Bus_GetCost(&cost);
+    DS3231_GetStats(&stats);
+    for(fn = 0; fn < DS3231_FN_COUNT; fn++)
+    {
+      transactions += stats.fn[fn].transactions;
+      bytes += stats.fn[fn].bytes;
+    }
+    us100 = DS3231_Bus_EstimateTime_us(&cost, DS3231_BUS_100KHZ);
+    us400 = DS3231_Bus_EstimateTime_us(&cost, DS3231_BUS_400KHZ);
+
+    if(r == 0)
+    {
+      printf("DS3231_%s: no row in the budget table\n", e->call_name);
+      errors++;
+      continue;
+    }
+    r->used = 1;
+    printf("DS3231_%-27s %6u / %-4u %6u / %-4u %7lu / %-5u %7lu / %-5u %8lu", e->call_name, cost.starts, r->starts,
+           cost.bytes, r->bytes, (unsigned long)us100, r->us100, (unsigned long)us400, r->us400,
+           (unsigned long)stats.fn[e->fn].ticks);
+    if(ret != 0)
+    {
+      printf("  FAILED (returned %u)\n", ret);
+      errors++;
+    }
+    else if(cost.starts > r->starts || cost.bytes > r->bytes || us100 > r->us100 || us400 > r->us400)
+    {
+      printf("  OVER BUDGET\n");
+      errors++;
+    }
+    else if(transactions != cost.stops || bytes != cost.bytes || stats.fn[e->fn].transactions != transactions ||
+            stats.fn[e->fn].bytes != bytes || (e->fn != DS3231_FN_OTHER && stats.fn[e->fn].calls != 1))
+    {
+      printf("  STATS MISMATCH (%u calls, %u transactions, %u bytes)\n", stats.fn[e->fn].calls,
+             stats.fn[e->fn].transactions, stats.fn[e->fn].bytes);
+      errors++;
+    }
+    else if(cost.starts < r->starts || cost.bytes < r->bytes)
+      printf("  below budget, update the table\n");
+    else
+      printf("\n");
+  }
+
+  for(i = 0; i < row_count; i++)
+  {
+    if(!rows[i].used)
+    {
+      printf("%s: row without a measurement\n", rows[i].name);
+      errors++;
+    }
+  }
+
+  printf("%u errors\n", errors);
+  return errors != 0;
+}
@@ -0,0 +1,101 @@
+// Checks the date conversions of DS3231.c against a reference calendar that walks day by day
+// from 2000-01-01 (a saturday, 2100 is no leap year):
+//  - DS3231_DateTimeToSeconds for every day of 2000 to 2199 (modulo 2^32 after 2136-02-07)
+//  - DS3231_SecondsToDateTime and the round trip for the first, a middle and the last second
+//    of every day, with "full" as argument for every 32 bit second count (about 100 s)
+//  - DS3231_EpochToDateTime/DS3231_DateTimeToEpoch at the ends of their ranges
+// Exits with 1 if a check failed.
+
+#include "DS3231.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK(cond) do { checks++; if(!(cond)) { failed++; if(failed <= 10) printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while(0)
+
+static unsigned long long checks, failed;
+
+static unsigned Days_In_Month(unsigned month, unsigned year)
+{
+  static const unsigned char days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  return days[month - 1] + (month == 2 && (year % 4) == 0 && year != 100);
+}
+
+// the second s of the day with the reference date ref
+static int Check_Second(uint32_t s, const struct DS3231_DateTime* ref)
+{
+  struct DS3231_DateTime dt;
+  uint32_t sec = s % 86400;
+
+  DS3231_SecondsToDateTime(s, &dt);
+  if(dt.seconds != sec % 60 || dt.minutes != (sec / 60) % 60 || dt.hours != sec / 3600 || dt.day != ref->day ||
+     dt.day_of_month != ref->day_of_month || dt.month != ref->month || dt.year != ref->year ||
+     DS3231_DateTimeToSeconds(&dt) != s)
+  {
+    printf("second %lu: %u-%02u-%02u %02u:%02u:%02u day %u\n", (unsigned long)s, 2000 + dt.year, dt.month,
+           dt.day_of_month, dt.hours, dt.minutes, dt.seconds, dt.day);
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  struct DS3231_DateTime ref = {0, 0, 0, SATURDAY, 1, 1, 0}, dt;
+  int quick = !(argc > 1 && strcmp(argv[1], "full") == 0);
+  uint32_t days = 0, s;
+  uint64_t first;
+
+  for(;;)
+  {
+    first = (uint64_t)days * 86400;
+    CHECK(DS3231_DateTimeToSeconds(&ref) == (uint32_t)first);
+
+    if(first <= 0xFFFFFFFFUL)
+    {
+      uint32_t last = (first + 86399 > 0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (uint32_t)first + 86399;
+      if(quick)
+      {
+        CHECK(Check_Second((uint32_t)first, &ref));
+        CHECK(Check_Second((uint32_t)first + (last - (uint32_t)first) / 2 + (days % 3600), &ref));
+        CHECK(Check_Second(last, &ref));
+      }
+      else
+      {
+        for(s = (uint32_t)first; ; s++)
+        {
+          checks++;
+          if(!Check_Second(s, &ref) && ++failed > 10)
+            return 1;
+          if(s == last)
+            break;
+        }
+      }
+    }
+
+    // next day of the reference calendar
+    days++;
+    ref.day = (ref.day == SUNDAY) ? MONDAY : ref.day + 1;
+    if(++ref.day_of_month > Days_In_Month(ref.month, ref.year))
+    {
+      ref.day_of_month = 1;
+      if(++ref.month > 12)
+      {
+        ref.month = 1;
+        if(++ref.year == 200)
+          break;
+      }
+    }
+  }
+  CHECK(days == 73049); // 2000-01-01 to 2199-12-31
+
+  // unix time: the first second of 2000, the last second of the 32 bit range
+  CHECK(DS3231_EpochToDateTime(DS3231_EPOCH_2000 - 1, &dt) == 2);
+  CHECK(DS3231_EpochToDateTime(DS3231_EPOCH_2000, &dt) == 0 && dt.year == 0 && dt.month == 1 && dt.day_of_month == 1 &&
+        dt.hours == 0 && dt.minutes == 0 && dt.seconds == 0 && dt.day == SATURDAY);
+  CHECK(DS3231_EpochToDateTime(0xFFFFFFFFUL, &dt) == 0 && dt.year == 106 && dt.month == 2 && dt.day_of_month == 7 &&
+        dt.hours == 6 && dt.minutes == 28 && dt.seconds == 15 && dt.day == SUNDAY);
+  CHECK(DS3231_DateTimeToEpoch(&dt) == 0xFFFFFFFFUL);
+
+  printf("%llu checks, %llu failed\n", checks, failed);
+  return failed != 0;
+}
@@ -0,0 +1,95 @@
+// Runs DS3231.hpp against the simulated DS3231, compiled as C++11 with -pedantic: the C and the
+// C++ interface mixed on ds3231::AvrBus (the shadow copies of DS3231.c must stay valid) and the
+// direct register access of another backend. Exits with 1 if a check failed.
+
+#include "DS3231.hpp"
+#include "DS3231_Sim.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK(cond) do { checks++; if(!(cond)) { failed++; printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while(0)
+
+static unsigned checks, failed;
+
+typedef DS3231<ds3231::AvrBus> Rtc;
+
+// a backend that is not the device of the C API, e.g. a second bus
+struct DirectBus
+{
+  static uint8_t read(uint8_t reg, uint8_t* buf, uint8_t len) { return DS3231_Bus_Read(reg, buf, len); }
+  static uint8_t write(uint8_t reg, const uint8_t* buf, uint8_t len) { return DS3231_Bus_Write(reg, buf, len); }
+};
+typedef DS3231<DirectBus> Direct;
+
+static void Setup(void)
+{
+  struct DS3231_Init_Struct init;
+
+  DS3231_Sim_Reset();
+  DS3231_InvalidateCache();
+  memset(&init, 0, sizeof(init));
+  init.SquareWaveOrInterrupt = ds3231::ctrl::INTCN;
+  CHECK(DS3231_Init(&init) == 0);
+  CHECK(DS3231_ClearOscillatorStopFlag() == 0);
+}
+
+static void Test_Shadows(void)
+{
+  Setup();
+
+  // control register: a C call after a C++ call keeps the square wave
+  CHECK(Rtc::setSquareWave<1024>() == 0);
+  CHECK(DS3231_ModifyControl(ds3231::ctrl::A1IE, ds3231::ctrl::A1IE) == 0);
+  CHECK(DS3231_Sim_ReadRegister(CTRL_ADDRESS) == (ds3231::SquareWaveBits(1024) | ds3231::ctrl::A1IE));
+
+  // status register: the EN32kHz bit survives clearing a flag through the C API
+  CHECK(Rtc::enable32kHzOutput(true) == 0);
+  CHECK(DS3231_ClearAlarm1Flag() == 0);
+  CHECK(DS3231_Sim_ReadRegister(STATUS_ADDRESS) & ds3231::status::EN32kHz);
+  CHECK(Rtc::enable32kHzOutput(false) == 0);
+  CHECK(Rtc::clearFlags(ds3231::status::A1F | ds3231::status::A2F) == 0);
+  CHECK(!(DS3231_Sim_ReadRegister(STATUS_ADDRESS) & ds3231::status::EN32kHz));
+
+  // alarm 1: the C setter is not skipped after the C++ setter changed the registers
+  CHECK(DS3231_SetAlarm1(10, 20, 3, 255, 4) == 0);
+  CHECK((Rtc::setAlarm1<ds3231::alarm1::MatchSeconds>(30, 0, 0, 1)) == 0);
+  CHECK(DS3231_Sim_ReadRegister(ALARM1_SEC_ADDRESS) == 0x30);
+  CHECK(DS3231_SetAlarm1(10, 20, 3, 255, 4) == 0);
+  CHECK(DS3231_Sim_ReadRegister(ALARM1_SEC_ADDRESS) == 0x10);
+
+  // date and time, validated like DS3231_SetDateTime
+  struct DS3231_DateTime dt = {1, 2, 3, MONDAY, 4, 5, 6}, rd;
+  CHECK(Rtc::setDateTime(dt) == 0);
+  CHECK(Rtc::readDateTime(rd) == 0 && memcmp(&dt, &rd, sizeof(dt)) == 0);
+  dt.month = 13;
+  CHECK(Rtc::setDateTime(dt) == 7);
+}
+
+static void Test_Direct(void)
+{
+  struct DS3231_DateTime dt = {59, 59, 23, SUNDAY, 31, 12, 120}, rd;
+  uint8_t value;
+
+  Setup();
+  CHECK(Direct::setDateTime(dt) == 0);
+  CHECK(Direct::readDateTime(rd) == 0 && memcmp(&dt, &rd, sizeof(dt)) == 0);
+  dt.hours = 24;
+  CHECK(Direct::setDateTime(dt) == 4);
+
+  CHECK(Direct::setSquareWave<8192>() == 0);
+  CHECK(DS3231_Sim_ReadRegister(CTRL_ADDRESS) == ds3231::SquareWaveBits(8192));
+  CHECK((Direct::setAlarm2<ds3231::alarm2::MatchHoursMinutes>(15, 7, 1)) == 0);
+  CHECK(DS3231_Sim_ReadRegister(ALARM2_MIN_ADDRESS) == 0x15);
+  CHECK(Direct::enable32kHzOutput(true) == 0);
+  CHECK(Direct::clearFlags(ds3231::status::A1F) == 0);
+  CHECK(Direct::readStatus(value) == 0 && (value & ds3231::status::EN32kHz));
+}
+
+int main(void)
+{
+  Test_Shadows();
+  Test_Direct();
+
+  printf("%u checks, %u failed\n", checks, failed);
+  return failed != 0;
+}
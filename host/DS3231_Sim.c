@@ -0,0 +1,893 @@
+#include "DS3231_Sim.h"
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "Gpio.h"
+#include "Timer.h"
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/twi.h>
+#include <string.h>
+
+#define TWCR_DONE 0x02 // reserved bit 1 of TWCR: set once the simulation has carried out the last write
+
+#define CTRL_CONV 0x20
+#define CTRL_INTCN 0x04
+#define CTRL_RS 0x18
+#define CTRL_A2IE 0x02
+#define CTRL_A1IE 0x01
+#define STATUS_OSF 0x80
+#define STATUS_EN32KHZ 0x08
+#define STATUS_BSY 0x04
+#define STATUS_A2F 0x02
+#define STATUS_A1F 0x01
+
+#define CONVERSION_NS 125000000UL // duration of a temperature conversion (125 ms typical)
+#define EEPROM_SIZE 1024
+
+// state of the bus as seen by the TWI hardware and the DS3231
+#define BUS_IDLE    0 // no transaction (after a stop condition)
+#define BUS_ADDRESS 1 // start condition sent, the next byte is an address
+#define BUS_WRITE   2 // the DS3231 is addressed for writing
+#define BUS_READ    3 // the DS3231 is addressed for reading
+#define BUS_NACKED  4 // a byte was not acknowledged, only a start or stop condition continues
+#define BUS_MUX_WRITE 5 // a mux is addressed for writing
+#define BUS_MUX_READ  6 // a mux is addressed for reading
+
+volatile uint8_t DS3231_Sim_TWSR;
+volatile uint8_t DS3231_Sim_TWBR;
+volatile uint8_t DS3231_Sim_TWDR;
+volatile uint8_t DS3231_Sim_SREG;
+volatile uint8_t DS3231_Sim_EIMSK;
+volatile uint8_t DS3231_Sim_EICRA;
+volatile uint16_t DS3231_Sim_TCNT1;
+volatile uint8_t DS3231_Sim_TCCR1A;
+volatile uint8_t DS3231_Sim_TCCR1B;
+volatile uint8_t DS3231_Sim_TIMSK1;
+volatile uint8_t DS3231_Sim_TIFR1;
+
+void DS3231_Sim_INT0_vect(void) __attribute__((weak)); // ISR(INT0_vect) of the program, if it has one
+
+static volatile uint8_t twcr = TWCR_DONE;
+static uint8_t regs[REGISTER_COUNT];
+static uint8_t latched[7]; // copy of the time registers taken on the start condition
+static uint8_t bus = BUS_IDLE;
+static uint8_t pointer_next; // 1 if the next written byte is the register pointer
+static uint8_t ptr; // register pointer
+
+static uint64_t now_ns; // time since DS3231_Sim_Reset
+static uint32_t subsec_ns; // time since the last second of the countdown chain
+static uint32_t conversion_ns; // remaining time of the running temperature conversion, 0 if none
+static uint32_t cpu_freq = SYSCLOCKFREQ;
+
+static uint8_t fault_count[DS3231_SIM_FAULTS];
+static uint8_t sda_stuck; // SCL pulses until the DS3231 releases SDA, 0 if SDA is free
+static uint8_t sda_driven; // SDA pulled low by the port pin (bus recovery)
+static uint8_t scl_driven; // SCL pulled low by the port pin (bus recovery)
+
+static uint32_t early_wake_ns; // next sleep ends after this time without an interrupt, 0 if not set
+static uint16_t sleep_limit_hits;
+static uint8_t eeprom[EEPROM_SIZE];
+static uint32_t eeprom_writes;
+
+static uint8_t mux_present; // bit n set if a TCA9548A answers at address 0x70 + n
+static uint8_t mux_channels[8]; // channel register of each mux
+static uint8_t mux_sel; // the addressed mux (0 to 7)
+static uint16_t collisions;
+
+static uint8_t Sim_Bcd(uint8_t v)
+{
+  return (uint8_t)(((v / 10) << 4) | (v % 10));
+}
+
+static uint8_t Sim_Bin(uint8_t bcd)
+{
+  return (uint8_t)((bcd >> 4) * 10 + (bcd & 0x0F));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_Fault
+// Description: This function consumes one injected fault of a kind.
+// Arguments:
+//  - uint8_t fault: DS3231_SIM_...
+//
+// Returns: 1 if the fault hits this action, else 0
+static uint8_t Sim_Fault(uint8_t fault)
+{
+  if(fault_count[fault] == 0)
+    return 0;
+  fault_count[fault]--;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_Routed
+// Description: This function checks if the DS3231 is reachable when its address is sent:
+//              always without mux, else through an enabled mux channel. More than one enabled
+//              channel is counted as a collision.
+// Arguments: none
+//
+// Returns: 1 if the DS3231 answers, else 0
+static uint8_t Sim_Routed(void)
+{
+  uint8_t n, bit, on = 0;
+
+  if(mux_present == 0)
+    return 1;
+  for(n = 0; n < 8; n++)
+    for(bit = 0; bit < 8; bit++)
+      if((mux_present & (1 << n)) && (mux_channels[n] & (1 << bit)))
+        on++;
+  if(on > 1)
+    collisions++;
+  return on != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_IntPinLevel
+// Description: This function computes the level of the INT/SQW pin: with INTCN set it is low
+//              while an enabled alarm flag is set, else it outputs the square wave selected by
+//              RS2:RS1. The 1 Hz square wave falls when the seconds increment and rises 500 ms
+//              later.
+// Arguments: none
+//
+// Returns: the level of the pin (0 or 1)
+static uint8_t Sim_IntPinLevel(void)
+{
+  static const uint16_t freq[4] = {1, 1024, 4096, 8192};
+  uint8_t ctrl = regs[CTRL_ADDRESS];
+  uint8_t status = regs[STATUS_ADDRESS];
+
+  if(ctrl & CTRL_INTCN)
+    return !(((status & STATUS_A1F) && (ctrl & CTRL_A1IE)) || ((status & STATUS_A2F) && (ctrl & CTRL_A2IE)));
+  return (uint8_t)((((uint64_t)subsec_ns * 2 * freq[(ctrl & CTRL_RS) >> 3]) / 1000000000UL) & 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_DaysInMonth
+// Description: This function returns the length of a month as the DS3231 counts it (every
+//              year divisible by 4 is a leap year).
+// Arguments:
+//  - uint8_t month: the month (1 to 12)
+//  - uint8_t year: the year (0 to 99)
+//
+// Returns: the number of days
+static uint8_t Sim_DaysInMonth(uint8_t month, uint8_t year)
+{
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if(month == 2 && (year & 0x03) == 0)
+    return 29;
+  return days[(month >= 1 && month <= 12) ? month - 1 : 0];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_AlarmField
+// Description: This function compares one field of an alarm with the time.
+// Arguments:
+//  - uint8_t alarm: the alarm register (bit 7 = AxMy, set if the field is ignored)
+//  - uint8_t value: the time register the field is compared with
+//  - uint8_t mask: the valid bits of both registers
+//
+// Returns: 1 if the field matches or is ignored
+static uint8_t Sim_AlarmField(uint8_t alarm, uint8_t value, uint8_t mask)
+{
+  return (alarm & 0x80) || (alarm & mask) == (value & mask);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_AlarmDay
+// Description: This function compares the day/date field of an alarm with the time, DY/DT
+//              (bit 6) selects the day of the week.
+// Arguments:
+//  - uint8_t alarm: the day/date alarm register
+//
+// Returns: 1 if the field matches or is ignored
+static uint8_t Sim_AlarmDay(uint8_t alarm)
+{
+  if(alarm & 0x80)
+    return 1;
+  if(alarm & 0x40)
+    return (alarm & 0x07) == (regs[DAY_ADDRESS] & 0x07);
+  return (alarm & 0x3F) == (regs[DATE_ADDRESS] & 0x3F);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_TickSecond
+// Description: This function advances the time registers by one second (the century bit
+//              toggles when the year rolls over from 99 to 00) and sets the flag of every
+//              alarm that matches the new time. Alarm 2 is only checked at second 00.
+// Arguments: none
+//
+// Returns: nothing
+static void Sim_TickSecond(void)
+{
+  uint8_t sec = Sim_Bin(regs[SECONDS_ADDRESS] & 0x7F);
+  uint8_t min = Sim_Bin(regs[MINUTES_ADDRESS] & 0x7F);
+  uint8_t hour = Sim_Bin(regs[HOURS_ADDRESS] & 0x3F);
+  uint8_t day = regs[DAY_ADDRESS] & 0x07;
+  uint8_t date = Sim_Bin(regs[DATE_ADDRESS] & 0x3F);
+  uint8_t month = Sim_Bin(regs[MONTH_ADDRESS] & 0x1F);
+  uint8_t century = regs[MONTH_ADDRESS] & 0x80;
+  uint8_t year = Sim_Bin(regs[YEAR_ADDRESS]);
+
+  if(++sec == 60)
+  {
+    sec = 0;
+    if(++min == 60)
+    {
+      min = 0;
+      if(++hour == 24)
+      {
+        hour = 0;
+        day = (day >= 7) ? 1 : day + 1;
+        if(++date > Sim_DaysInMonth(month, year))
+        {
+          date = 1;
+          if(++month > 12)
+          {
+            month = 1;
+            if(++year == 100)
+            {
+              year = 0;
+              century ^= 0x80;
+            }
+          }
+        }
+      }
+    }
+  }
+  regs[SECONDS_ADDRESS] = Sim_Bcd(sec);
+  regs[MINUTES_ADDRESS] = Sim_Bcd(min);
+  regs[HOURS_ADDRESS] = Sim_Bcd(hour);
+  regs[DAY_ADDRESS] = day;
+  regs[DATE_ADDRESS] = Sim_Bcd(date);
+  regs[MONTH_ADDRESS] = Sim_Bcd(month) | century;
+  regs[YEAR_ADDRESS] = Sim_Bcd(year);
+
+  if(Sim_AlarmField(regs[ALARM1_SEC_ADDRESS], regs[SECONDS_ADDRESS], 0x7F) &&
+     Sim_AlarmField(regs[ALARM1_MIN_ADDRESS], regs[MINUTES_ADDRESS], 0x7F) &&
+     Sim_AlarmField(regs[ALARM1_HOUR_ADDRESS], regs[HOURS_ADDRESS], 0x3F) &&
+     Sim_AlarmDay(regs[ALARM1_DYDT_ADDRESS]))
+    regs[STATUS_ADDRESS] |= STATUS_A1F;
+  if(sec == 0 &&
+     Sim_AlarmField(regs[ALARM2_MIN_ADDRESS], regs[MINUTES_ADDRESS], 0x7F) &&
+     Sim_AlarmField(regs[ALARM2_HOUR_ADDRESS], regs[HOURS_ADDRESS], 0x3F) &&
+     Sim_AlarmDay(regs[ALARM2_DYDT_ADDRESS]))
+    regs[STATUS_ADDRESS] |= STATUS_A2F;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_Advance
+// Description: This function lets time pass: the countdown chain, the seconds and the
+//              running temperature conversion.
+// Arguments:
+//  - uint64_t ns: the time in nanoseconds
+//
+// Returns: nothing
+static void Sim_Advance(uint64_t ns)
+{
+  while(ns > 0)
+  {
+    uint64_t step = 1000000000UL - subsec_ns;
+    if(conversion_ns != 0 && conversion_ns < step)
+      step = conversion_ns;
+    if(step > ns)
+      step = ns;
+
+    ns -= step;
+    now_ns += step;
+    subsec_ns += (uint32_t)step;
+    if(conversion_ns != 0)
+    {
+      conversion_ns -= (uint32_t)step;
+      if(conversion_ns == 0)
+      {
+        regs[CTRL_ADDRESS] &= ~CTRL_CONV;
+        regs[STATUS_ADDRESS] &= ~STATUS_BSY;
+      }
+    }
+    if(subsec_ns == 1000000000UL)
+    {
+      subsec_ns = 0;
+      Sim_TickSecond();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_Clocks
+// Description: This function lets the time of a number of SCL periods pass, at the SCL
+//              frequency set by TWBR and the prescaler of TWSR.
+// Arguments:
+//  - uint8_t clocks: number of SCL periods
+//
+// Returns: nothing
+static void Sim_Clocks(uint8_t clocks)
+{
+  uint32_t div = 16 + 2UL * DS3231_Sim_TWBR * (1UL << (2 * (DS3231_Sim_TWSR & 0x03)));
+  Sim_Advance((uint64_t)clocks * div * 1000000000UL / cpu_freq);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_Latch
+// Description: This function copies the time registers into the buffer the DS3231 reads
+//              them from, done on every start condition and when the pointer wraps to 0.
+// Arguments: none
+//
+// Returns: nothing
+static void Sim_Latch(void)
+{
+  memcpy(latched, regs, sizeof(latched));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_WriteRegister
+// Description: This function stores a byte written over the bus: the seconds reset the
+//              countdown chain, CONV starts a conversion (unless one is running), the flags
+//              of the status register can only be cleared and BSY is read only, the
+//              temperature registers are read only.
+// Arguments:
+//  - uint8_t reg: the register
+//  - uint8_t value: the written value
+//
+// Returns: nothing
+static void Sim_WriteRegister(uint8_t reg, uint8_t value)
+{
+  uint8_t old = regs[reg];
+
+  switch(reg)
+  {
+    case SECONDS_ADDRESS:
+      regs[reg] = value & 0x7F;
+      subsec_ns = 0;
+      break;
+    case CTRL_ADDRESS:
+      regs[reg] = (value & ~CTRL_CONV) | (old & CTRL_CONV);
+      if((value & CTRL_CONV) && !(regs[STATUS_ADDRESS] & STATUS_BSY))
+      {
+        regs[reg] |= CTRL_CONV;
+        regs[STATUS_ADDRESS] |= STATUS_BSY;
+        conversion_ns = CONVERSION_NS;
+      }
+      break;
+    case STATUS_ADDRESS:
+      regs[reg] = (old & value & (STATUS_OSF | STATUS_A2F | STATUS_A1F)) | (old & STATUS_BSY) | (value & STATUS_EN32KHZ);
+      break;
+    case TEMP_MSB_ADDRESS:
+    case TEMP_LSB_ADDRESS:
+      break;
+    default:
+      regs[reg] = value;
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_Complete
+// Description: This function ends a TWI action: the status code goes into TWSR and TWINT
+//              is set.
+// Arguments:
+//  - uint8_t status: the TWI status code
+//
+// Returns: nothing
+static void Sim_Complete(uint8_t status)
+{
+  DS3231_Sim_TWSR = (DS3231_Sim_TWSR & 0x03) | status;
+  twcr |= (1<<TWINT);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Sim_TwiAction
+// Description: This function carries out a write of TWCR the way the TWI hardware and the
+//              DS3231 react to it. Writing TWINT starts the action selected by TWSTO, TWSTA
+//              or (neither) a byte transfer of TWDR; TWINT is set again when it completed.
+//              A stop condition clears TWSTO and does not set TWINT. While SDA is held low no
+//              start or stop condition can be generated.
+// Arguments:
+//  - uint8_t value: the value written to TWCR
+//
+// Returns: nothing
+static void Sim_TwiAction(uint8_t value)
+{
+  uint8_t sda_low = sda_stuck || sda_driven;
+  uint8_t data;
+
+  twcr = value | TWCR_DONE;
+  if(!(value & (1<<TWEN)))
+  {
+    bus = BUS_IDLE; // the TWI is disconnected from the pins, the DS3231 keeps its state (e.g. SDA held)
+    return;
+  }
+  if(!(value & (1<<TWINT)))
+    return;
+  twcr &= ~(1<<TWINT);
+
+  if(value & (1<<TWSTO))
+  {
+    if(sda_low)
+      return; // the stop condition can not be generated, TWSTO stays set
+    Sim_Clocks(1);
+    bus = BUS_IDLE;
+    twcr &= ~(1<<TWSTO);
+    if(!(value & (1<<TWSTA)))
+      return;
+  }
+  if(Sim_Fault(DS3231_SIM_TIMEOUT))
+    return;
+  if(Sim_Fault(DS3231_SIM_ARB_LOST))
+  {
+    bus = BUS_IDLE;
+    Sim_Complete(TW_MT_ARB_LOST);
+    return;
+  }
+
+  if(value & (1<<TWSTA))
+  {
+    if(sda_low)
+      return; // the TWI waits for a free bus
+    Sim_Clocks(1);
+    Sim_Latch();
+    Sim_Complete((bus == BUS_IDLE) ? TW_START : TW_REP_START);
+    bus = BUS_ADDRESS;
+    return;
+  }
+
+  Sim_Clocks(9); // 8 bits and the acknowledge
+  data = DS3231_Sim_TWDR;
+  switch(bus)
+  {
+    case BUS_ADDRESS:
+      if((data >> 4) == 0x0E && (mux_present & (1 << ((data >> 1) & 0x07))) && !Sim_Fault(DS3231_SIM_NACK_ADDRESS))
+      {
+        mux_sel = (data >> 1) & 0x07;
+        bus = (data & TW_READ) ? BUS_MUX_READ : BUS_MUX_WRITE;
+        Sim_Complete((data & TW_READ) ? TW_MR_SLA_ACK : TW_MT_SLA_ACK);
+      }
+      else if((data & 0xFE) != DS3231_I2C_ADDRESS || !Sim_Routed() || Sim_Fault(DS3231_SIM_NACK_ADDRESS))
+      {
+        bus = BUS_NACKED;
+        Sim_Complete((data & TW_READ) ? TW_MR_SLA_NACK : TW_MT_SLA_NACK);
+      }
+      else if(data & TW_READ)
+      {
+        bus = BUS_READ;
+        Sim_Complete(TW_MR_SLA_ACK);
+      }
+      else
+      {
+        bus = BUS_WRITE;
+        pointer_next = 1;
+        Sim_Complete(TW_MT_SLA_ACK);
+      }
+      break;
+
+    case BUS_WRITE:
+      if(Sim_Fault(DS3231_SIM_NACK_DATA))
+      {
+        bus = BUS_NACKED;
+        Sim_Complete(TW_MT_DATA_NACK);
+        break;
+      }
+      if(pointer_next)
+      {
+        ptr = data % REGISTER_COUNT;
+        pointer_next = 0;
+      }
+      else
+      {
+        Sim_WriteRegister(ptr, data);
+        ptr = (ptr + 1) % REGISTER_COUNT;
+      }
+      Sim_Complete(TW_MT_DATA_ACK);
+      break;
+
+    case BUS_READ:
+      DS3231_Sim_TWDR = (ptr <= YEAR_ADDRESS) ? latched[ptr] : regs[ptr];
+      ptr = (ptr + 1) % REGISTER_COUNT;
+      if(ptr == 0)
+        Sim_Latch();
+      Sim_Complete((value & (1<<TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK);
+      break;
+
+    case BUS_MUX_WRITE:
+      if(Sim_Fault(DS3231_SIM_NACK_DATA))
+      {
+        bus = BUS_NACKED;
+        Sim_Complete(TW_MT_DATA_NACK);
+        break;
+      }
+      mux_channels[mux_sel] = data;
+      Sim_Complete(TW_MT_DATA_ACK);
+      break;
+
+    case BUS_MUX_READ:
+      DS3231_Sim_TWDR = mux_channels[mux_sel];
+      Sim_Complete((value & (1<<TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK);
+      break;
+
+    default:
+      Sim_Complete(TW_BUS_ERROR); // a byte without a start condition
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_TWCR
+// Description: This function is behind every access of TWCR (avr/io.h of the host). The last
+//              written value is carried out first, so the program sees the result of its
+//              previous action (TWINT, TWSTO) on the next read.
+// Arguments: none
+//
+// Returns: pointer to the TWCR value
+volatile uint8_t* DS3231_Sim_TWCR(void)
+{
+  if(!(twcr & TWCR_DONE))
+    Sim_TwiAction(twcr);
+  return &twcr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Reset
+// Description: This function powers the simulated DS3231 up: 2000-01-01 00:00:00 (a
+//              saturday, day 6), control register 0x1C, status register 0x88 (OSF set),
+//              alarms and aging offset 0, 25.25 degree Celsius. The bus becomes idle, injected
+//              faults are dropped and the EEPROM is erased.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Sim_Reset(void)
+{
+  memset(regs, 0, sizeof(regs));
+  regs[DAY_ADDRESS] = SATURDAY;
+  regs[DATE_ADDRESS] = 0x01;
+  regs[MONTH_ADDRESS] = 0x01;
+  regs[CTRL_ADDRESS] = 0x1C;
+  regs[STATUS_ADDRESS] = STATUS_OSF | STATUS_EN32KHZ;
+  regs[TEMP_MSB_ADDRESS] = 25;
+  regs[TEMP_LSB_ADDRESS] = 0x40;
+  Sim_Latch();
+
+  twcr = TWCR_DONE;
+  bus = BUS_IDLE;
+  ptr = 0;
+  now_ns = 0;
+  subsec_ns = 0;
+  conversion_ns = 0;
+  memset(fault_count, 0, sizeof(fault_count));
+  sda_stuck = 0;
+  sda_driven = 0;
+  scl_driven = 0;
+  early_wake_ns = 0;
+  sleep_limit_hits = 0;
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  eeprom_writes = 0;
+  mux_present = 0;
+  memset(mux_channels, 0, sizeof(mux_channels));
+  collisions = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_SetCpuFrequency
+// Description: This function sets the CPU frequency the SCL frequency is derived from, it
+//              must match the CpuFrequency of DS3231_Init (default SYSCLOCKFREQ).
+// Arguments:
+//  - uint32_t hz: the CPU frequency in Hz
+//
+// Returns: nothing
+void DS3231_Sim_SetCpuFrequency(uint32_t hz)
+{
+  cpu_freq = hz;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_InjectFault
+// Description: This function makes the next count actions that can have the fault fail with
+//              it, e.g. the next count address bytes for DS3231_SIM_NACK_ADDRESS.
+// Arguments:
+//  - uint8_t fault: DS3231_SIM_NACK_ADDRESS, DS3231_SIM_NACK_DATA, DS3231_SIM_ARB_LOST or
+//                   DS3231_SIM_TIMEOUT
+//  - uint8_t count: number of failing actions, 0 drops pending faults of this kind
+//
+// Returns: nothing
+void DS3231_Sim_InjectFault(uint8_t fault, uint8_t count)
+{
+  if(fault < DS3231_SIM_FAULTS)
+    fault_count[fault] = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_StickSDA
+// Description: This function makes the DS3231 hold SDA low, as after a reset of the
+//              microcontroller in the middle of a read (the DS3231 still outputs a 0 bit). SDA
+//              is released after the given number of SCL pulses.
+// Arguments:
+//  - uint8_t pulses: SCL pulses until SDA is released (1 to 9), DS3231_SIM_SDA_FOREVER for a
+//                    bus that can not be recovered, 0 releases SDA
+//
+// Returns: nothing
+void DS3231_Sim_StickSDA(uint8_t pulses)
+{
+  sda_stuck = pulses;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_ReadRegister
+// Description: This function returns a register of the simulated DS3231 without using the bus.
+// Arguments:
+//  - uint8_t reg: the register (0x00 to 0x12)
+//
+// Returns: the register value
+uint8_t DS3231_Sim_ReadRegister(uint8_t reg)
+{
+  DS3231_Sim_TWCR();
+  return regs[reg % REGISTER_COUNT];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_WriteRegister
+// Description: This function sets a register of the simulated DS3231 without using the bus
+//              and without the write rules of the bus (e.g. to set an alarm flag, the
+//              temperature or OSF).
+// Arguments:
+//  - uint8_t reg: the register (0x00 to 0x12)
+//  - uint8_t value: the new value
+//
+// Returns: nothing
+void DS3231_Sim_WriteRegister(uint8_t reg, uint8_t value)
+{
+  DS3231_Sim_TWCR();
+  regs[reg % REGISTER_COUNT] = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Advance_us
+// Description: This function lets time pass for the simulated DS3231.
+// Arguments:
+//  - uint32_t us: the time in microseconds
+//
+// Returns: nothing
+void DS3231_Sim_Advance_us(uint32_t us)
+{
+  DS3231_Sim_TWCR();
+  Sim_Advance((uint64_t)us * 1000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Time_us
+// Description: This function returns the simulated time since DS3231_Sim_Reset.
+// Arguments: none
+//
+// Returns: the time in microseconds
+uint64_t DS3231_Sim_Time_us(void)
+{
+  return now_ns / 1000;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Subsecond_us
+// Description: This function returns the position of the countdown chain, the time since
+//              the seconds register last incremented (or was written).
+// Arguments: none
+//
+// Returns: the time in microseconds (0 to 999999)
+uint32_t DS3231_Sim_Subsecond_us(void)
+{
+  return subsec_ns / 1000;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_IntPin
+// Description: This function returns the level of the INT/SQW pin.
+// Arguments: none
+//
+// Returns: 0 (low) or 1 (high)
+uint8_t DS3231_Sim_IntPin(void)
+{
+  DS3231_Sim_TWCR();
+  return Sim_IntPinLevel();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Ticks
+// Description: This function is the free running counter of the host build (DS3231_TICKS),
+//              one tick per simulated microsecond.
+// Arguments: none
+//
+// Returns: the low 16 bits of the simulated time in microseconds
+uint16_t DS3231_Sim_Ticks(void)
+{
+  return (uint16_t)(now_ns / 1000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_WakeEarly
+// Description: This function makes the next sleep end after the given time without an
+//              interrupt of the DS3231 (another interrupt woke the microcontroller).
+// Arguments:
+//  - uint32_t us: time from the start of the sleep in microseconds, 0 cancels
+//
+// Returns: nothing
+void DS3231_Sim_WakeEarly(uint32_t us)
+{
+  early_wake_ns = us * 1000;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Sleep
+// Description: This function is sleep_cpu of the host: time passes until INT0 is enabled
+//              (EIMSK) and the INT/SQW pin is low, then ISR(INT0_vect) of the program is called.
+//              A sleep that would last longer than DS3231_SIM_SLEEP_LIMIT seconds (the alarm
+//              never fires) ends without the interrupt and is counted, see
+//              DS3231_Sim_SleepLimitHits.
+// Arguments: none
+//
+// Returns: nothing
+void DS3231_Sim_Sleep(void)
+{
+  uint64_t early = early_wake_ns;
+  uint32_t seconds;
+
+  DS3231_Sim_TWCR();
+  early_wake_ns = 0;
+  for(seconds = 0; seconds <= DS3231_SIM_SLEEP_LIMIT; seconds++)
+  {
+    if((DS3231_Sim_EIMSK & (1<<INT0)) && !Sim_IntPinLevel())
+    {
+      if(DS3231_Sim_INT0_vect != 0)
+        DS3231_Sim_INT0_vect();
+      return;
+    }
+
+    uint64_t step = (Sim_IntPinLevel() && !(regs[CTRL_ADDRESS] & CTRL_INTCN) && subsec_ns < 500000000UL) ?
+                    500000000UL - subsec_ns : 1000000000UL - subsec_ns; // to the next edge of the pin
+    if(early != 0 && early <= step)
+    {
+      Sim_Advance(early);
+      return;
+    }
+    if(early != 0)
+      early -= step;
+    Sim_Advance(step);
+  }
+  sleep_limit_hits++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_SleepLimitHits
+// Description: This function returns how many sleeps ended at DS3231_SIM_SLEEP_LIMIT
+//              because no interrupt came, on the target these would never end.
+// Arguments: none
+//
+// Returns: the number of sleeps since DS3231_Sim_Reset
+uint16_t DS3231_Sim_SleepLimitHits(void)
+{
+  return sleep_limit_hits;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_EepromWrites
+// Description: This function returns the number of EEPROM bytes written since
+//              DS3231_Sim_Reset (eeprom_update_byte calls that changed a byte).
+// Arguments: none
+//
+// Returns: the number of write cycles
+uint32_t DS3231_Sim_EepromWrites(void)
+{
+  return eeprom_writes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Eeprom
+// Description: This function returns the content of the simulated EEPROM (1 KB).
+// Arguments: none
+//
+// Returns: pointer to the EEPROM bytes
+const uint8_t* DS3231_Sim_Eeprom(void)
+{
+  return eeprom;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_AddMux
+// Description: This function connects a TCA9548A to the bus, all its channels are off (as
+//              after its power-on), DS3231_Sim_Reset removes it again. With a mux on the bus the
+//              DS3231 only answers while a channel is on.
+// Arguments:
+//  - uint8_t a2a1a0: level of the address pins of the mux (0 to 7, see DS3231_MUX_ADDRESS)
+//
+// Returns: nothing
+void DS3231_Sim_AddMux(uint8_t a2a1a0)
+{
+  mux_present |= (uint8_t)(1 << (a2a1a0 & 0x07));
+  mux_channels[a2a1a0 & 0x07] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_MuxChannels
+// Description: This function returns the channel register of a mux.
+// Arguments:
+//  - uint8_t a2a1a0: level of the address pins of the mux (0 to 7)
+//
+// Returns: the enabled channels, bit n = channel n
+uint8_t DS3231_Sim_MuxChannels(uint8_t a2a1a0)
+{
+  return mux_channels[a2a1a0 & 0x07];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: DS3231_Sim_Collisions
+// Description: This function returns how often the DS3231 was addressed while more than one
+//              mux channel was on (several DS3231 would have answered at once).
+// Arguments: none
+//
+// Returns: the number of collisions since DS3231_Sim_Reset
+uint16_t DS3231_Sim_Collisions(void)
+{
+  return collisions;
+}
+
+uint8_t eeprom_read_byte(const uint8_t* addr)
+{
+  return eeprom[(uintptr_t)addr % EEPROM_SIZE];
+}
+
+void eeprom_update_byte(uint8_t* addr, uint8_t value)
+{
+  uint16_t a = (uintptr_t)addr % EEPROM_SIZE;
+  if(eeprom[a] == value)
+    return;
+  eeprom[a] = value;
+  eeprom_writes++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: GPIO_PinMode
+// Description: Host version of the Gpio driver: an output pulls its line low, an input
+//              releases it. A rising edge of SCL while the DS3231 holds SDA clocks out one
+//              bit, SDA rising while SCL is high is a stop condition.
+// Arguments: see the Gpio driver
+//
+// Returns: nothing
+void GPIO_PinMode(uint8_t port, uint8_t pin, uint8_t mode, uint8_t pull)
+{
+  (void)pull;
+  DS3231_Sim_TWCR();
+  if(port != GPIOC)
+    return;
+
+  if(pin == GPIO_PIN_5)
+  {
+    if(scl_driven && mode == GPIO_INPUT && sda_stuck != 0 && sda_stuck != DS3231_SIM_SDA_FOREVER)
+      sda_stuck--;
+    scl_driven = (mode == GPIO_OUTPUT);
+  }
+  else if(pin == GPIO_PIN_4)
+  {
+    if(sda_driven && mode == GPIO_INPUT && !scl_driven && !sda_stuck)
+      bus = BUS_IDLE; // stop condition
+    sda_driven = (mode == GPIO_OUTPUT);
+  }
+}
+
+uint8_t GPIO_ReadPin(uint8_t port, uint8_t pin)
+{
+  DS3231_Sim_TWCR();
+  if(port == GPIOC && pin == GPIO_PIN_4)
+    return !(sda_stuck || sda_driven);
+  if(port == GPIOC && pin == GPIO_PIN_5)
+    return !scl_driven;
+  if(port == GPIOD && pin == GPIO_PIN_2)
+    return Sim_IntPinLevel();
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Name: Timer0_Delay_us
+// Description: Host version of the Timer driver, the delay is simulated time.
+// Arguments:
+//  - uint16_t us: the delay in microseconds
+//
+// Returns: nothing
+void Timer0_Delay_us(uint16_t us)
+{
+  DS3231_Sim_Advance_us(us);
+}
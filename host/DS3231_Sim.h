@@ -0,0 +1,67 @@
+#ifndef DS3231_SIM_HEADER
+#define DS3231_SIM_HEADER
+
+// Register level simulation of a DS3231 on the TWI bus of an ATmega328, for running the lib on a
+// host. The mock headers in host/include turn the TWI registers, the pins and the delays of the
+// lib into calls of this module, so the unmodified DS3231_Bus.c (queue, retries, recovery, bus
+// accounting) drives the simulated chip. Simulated are:
+//  - the 19 registers (0x00 to 0x12) with the auto-incremented register pointer, the time
+//    registers are read from a copy taken on the start condition (as the DS3231 does)
+//  - the oscillator: time only passes by DS3231_Sim_Advance_us, Timer0_Delay_us and the SCL
+//    clocks of every bus action (at the frequency set by TWBR/TWSR and DS3231_Sim_SetCpuFrequency)
+//  - writing the seconds register resets the countdown chain (the next second is 1 s later)
+//  - the calendar with the century bit, the alarm match logic (A1F, A2F), the INT/SQW pin
+//    (alarm interrupt or square wave) on PD2, temperature conversions (CONV, BSY, 125 ms)
+//  - the OSF, A1F and A2F flags can only be cleared, BSY is read only
+//  - faults: NACK of the address or of a written byte, lost arbitration, an action that never
+//    completes (timeout) and SDA held low by the DS3231 until SCL is pulsed
+//  - a 1 KB EEPROM (avr/eeprom.h) that counts its write cycles
+//  - TCA9548A muxes (DS3231_Sim_AddMux): their channel register is written and read like the
+//    chip's, the DS3231 stands for one device on every channel and only answers while a channel
+//    is on, it counts a collision when more than one channel is on (DS3231_Sim_Collisions)
+// The DS3231 treats every year divisible by 4 as a leap year, so does the simulation (2100 too).
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// faults of DS3231_Sim_InjectFault
+#define DS3231_SIM_NACK_ADDRESS 0 // the DS3231 does not acknowledge its address (status 0x20 / 0x48)
+#define DS3231_SIM_NACK_DATA    1 // a written byte (register pointer or data) is not acknowledged (status 0x30)
+#define DS3231_SIM_ARB_LOST     2 // the arbitration is lost on the next start or byte (status 0x38)
+#define DS3231_SIM_TIMEOUT      3 // the next start or byte never completes (TWINT stays clear)
+#define DS3231_SIM_FAULTS       4
+
+#define DS3231_SIM_SDA_FOREVER 0xFF // DS3231_Sim_StickSDA: SDA is never released
+
+#ifndef DS3231_SIM_SLEEP_LIMIT
+#define DS3231_SIM_SLEEP_LIMIT (40UL*86400) // longest simulated sleep in seconds, see DS3231_Sim_Sleep
+#endif
+
+// simulation control
+void DS3231_Sim_Reset(void);
+void DS3231_Sim_SetCpuFrequency(uint32_t hz);
+void DS3231_Sim_InjectFault(uint8_t fault, uint8_t count);
+void DS3231_Sim_StickSDA(uint8_t pulses);
+uint8_t DS3231_Sim_ReadRegister(uint8_t reg);
+void DS3231_Sim_WriteRegister(uint8_t reg, uint8_t value);
+void DS3231_Sim_Advance_us(uint32_t us);
+uint64_t DS3231_Sim_Time_us(void);
+uint32_t DS3231_Sim_Subsecond_us(void);
+uint8_t DS3231_Sim_IntPin(void);
+uint16_t DS3231_Sim_Ticks(void);
+void DS3231_Sim_WakeEarly(uint32_t us);
+uint16_t DS3231_Sim_SleepLimitHits(void);
+uint32_t DS3231_Sim_EepromWrites(void);
+const uint8_t* DS3231_Sim_Eeprom(void);
+void DS3231_Sim_AddMux(uint8_t a2a1a0);
+uint8_t DS3231_Sim_MuxChannels(uint8_t a2a1a0);
+uint16_t DS3231_Sim_Collisions(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
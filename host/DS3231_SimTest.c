@@ -0,0 +1,470 @@
+// Runs the DS3231 lib against the simulated DS3231: register access, the retry and recovery
+// paths of DS3231_Bus.c under injected bus faults, alarms, temperature conversions, the event
+// log, the scheduler and the sleep. Exits with 1 if a check failed.
+
+#include "DS3231.h"
+#include "DS3231_Bus.h"
+#include "DS3231_Sched.h"
+#include "DS3231_Sleep.h"
+#include "DS3231_Log.h"
+#include "DS3231_Multi.h"
+#include "DS3231_Sim.h"
+#include <avr/interrupt.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK(cond) do { checks++; if(!(cond)) { failed++; printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while(0)
+
+static unsigned checks, failed;
+
+ISR(INT0_vect)
+{
+  DS3231_Sleep_WakeISR();
+}
+
+static void Setup(void)
+{
+  struct DS3231_Init_Struct init;
+
+  DS3231_Sim_Reset();
+  DS3231_InvalidateCache();
+  DS3231_ResetBusErrors();
+  DS3231_SetRetryPolicy(DS3231_BUS_RETRIES, DS3231_BUS_BACKOFF_US);
+  memset(&init, 0, sizeof(init));
+  init.SquareWaveOrInterrupt = INTERRUPT_FUNC;
+  CHECK(DS3231_Init(&init) == 0);
+  CHECK(DS3231_ClearOscillatorStopFlag() == 0);
+}
+
+static void Test_DateTime(void)
+{
+  struct DS3231_DateTime dt = {58, 59, 23, SUNDAY, 31, 12, 99}, rd;
+  uint32_t epoch;
+
+  Setup();
+  CHECK(DS3231_SetDateTime(&dt) == 0);
+  CHECK(DS3231_Sim_ReadRegister(SECONDS_ADDRESS) == 0x58);
+  CHECK(DS3231_Sim_ReadRegister(MONTH_ADDRESS) == 0x12);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  CHECK(memcmp(&dt, &rd, sizeof(dt)) == 0);
+
+  DS3231_Sim_Advance_us(2000000); // over the new year, the century bit toggles
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  CHECK(rd.year == 100 && rd.month == 1 && rd.day_of_month == 1 && rd.hours == 0 && rd.seconds == 0);
+  CHECK(rd.day == MONDAY);
+  CHECK(DS3231_Sim_ReadRegister(MONTH_ADDRESS) == 0x81);
+
+  CHECK(DS3231_SetEpoch(DS3231_EPOCH_2000 + 86400UL*60 - 1) == 0); // 2000-02-29 23:59:59
+  DS3231_Sim_Advance_us(1000000);
+  CHECK(DS3231_ReadEpoch(&epoch) == 0);
+  CHECK(epoch == DS3231_EPOCH_2000 + 86400UL*60);
+  CHECK(DS3231_Sim_ReadRegister(MONTH_ADDRESS) == 0x03 && DS3231_Sim_ReadRegister(DATE_ADDRESS) == 0x01);
+}
+
+static struct DS3231_DateTime async_dt[2];
+static uint8_t async_status[2];
+
+static void Async_Done0(uint8_t status)
+{
+  async_status[0] = status;
+}
+
+static void Async_Done1(uint8_t status)
+{
+  async_status[1] = status;
+}
+
+static void Test_Faults(void)
+{
+  struct DS3231_DateTime rd;
+  struct DS3231_BusErrors err;
+
+  // a NACK of the address is retried without a recovery
+  Setup();
+  DS3231_Sim_InjectFault(DS3231_SIM_NACK_ADDRESS, 1);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  DS3231_GetBusErrors(&err);
+  CHECK(err.retries == 1 && err.recoveries == 0 && err.failures == 0);
+
+  // more NACKs than retries: the status code of the last attempt is returned
+  DS3231_ResetBusErrors();
+  DS3231_Sim_InjectFault(DS3231_SIM_NACK_ADDRESS, DS3231_BUS_RETRIES + 1);
+  CHECK(DS3231_ReadDateTime(&rd) == 0x20);
+  DS3231_GetBusErrors(&err);
+  CHECK(err.retries == DS3231_BUS_RETRIES && err.failures == 1);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+
+  // a NACK of a data byte and a lost arbitration are retried
+  Setup();
+  DS3231_Sim_InjectFault(DS3231_SIM_NACK_DATA, 1);
+  CHECK(DS3231_SetTime(1, 2, 3) == 0);
+  DS3231_Sim_InjectFault(DS3231_SIM_ARB_LOST, 1);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  CHECK(rd.seconds == 1 && rd.minutes == 2 && rd.hours == 3);
+  DS3231_GetBusErrors(&err);
+  CHECK(err.retries == 2 && err.recoveries == 0);
+
+  // an action that never completes times out, the bus is recovered before the retry
+  Setup();
+  DS3231_Sim_InjectFault(DS3231_SIM_TIMEOUT, 1);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  DS3231_GetBusErrors(&err);
+  CHECK(err.retries == 1 && err.recoveries == 1 && err.failures == 0);
+
+  // SDA held by the DS3231: no start condition, timeout, recovery with SCL pulses
+  Setup();
+  DS3231_Sim_StickSDA(5);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  DS3231_GetBusErrors(&err);
+  CHECK(err.recoveries == 1 && err.failures == 0);
+
+  // SDA that is never released: every attempt fails, the bus works again once SDA is free
+  Setup();
+  DS3231_Sim_StickSDA(DS3231_SIM_SDA_FOREVER);
+  CHECK(DS3231_ReadDateTime(&rd) == 1);
+  DS3231_GetBusErrors(&err);
+  CHECK(err.failures == 1 && err.recoveries == DS3231_BUS_RETRIES);
+  CHECK(DS3231_Bus_Recover() == 1);
+  DS3231_Sim_StickSDA(0);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+
+  // a timeout aborts only the operation that is stuck, the queued ones are not affected
+  Setup();
+  async_status[0] = async_status[1] = 0xFF;
+  CHECK(DS3231_ReadDateTimeAsync(&async_dt[0], Async_Done0) == 0);
+  CHECK(DS3231_ReadDateTimeAsync(&async_dt[1], Async_Done1) == 0);
+  DS3231_Sim_InjectFault(DS3231_SIM_TIMEOUT, 1);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  CHECK(async_status[0] == 1 && async_status[1] == 0);
+
+  // a recovery restarts the active operation and keeps the queued ones
+  async_status[0] = async_status[1] = 0xFF;
+  CHECK(DS3231_ReadDateTimeAsync(&async_dt[0], Async_Done0) == 0);
+  CHECK(DS3231_ReadDateTimeAsync(&async_dt[1], Async_Done1) == 0);
+  CHECK(DS3231_Bus_Recover() == 0);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+  CHECK(async_status[0] == 0 && async_status[1] == 0);
+  CHECK(memcmp(&async_dt[0], &rd, sizeof(rd)) == 0);
+
+  // a recovery that can not free the bus aborts every queued operation
+  async_status[0] = 0xFF;
+  CHECK(DS3231_ReadDateTimeAsync(&async_dt[0], Async_Done0) == 0);
+  DS3231_Sim_StickSDA(DS3231_SIM_SDA_FOREVER);
+  CHECK(DS3231_Bus_Recover() == 1);
+  CHECK(async_status[0] == 1 && DS3231_Bus_Busy() == 0);
+  DS3231_Sim_StickSDA(0);
+
+  // recovery at start-up
+  Setup();
+  DS3231_Sim_StickSDA(9);
+  CHECK(DS3231_PutInKnownI2CState() == 0);
+  CHECK(DS3231_ReadDateTime(&rd) == 0);
+}
+
+static void Test_Alarms(void)
+{
+  uint8_t fired;
+
+  Setup();
+  CHECK(DS3231_SetDateTime(&(struct DS3231_DateTime){50, 0, 12, MONDAY, 3, 1, 0}) == 0);
+  CHECK(DS3231_SetAlarm1(55, 0, 12, 255, 3) == 0);
+  CHECK(DS3231_SetAlarm2(1, 12, 255, 3) == 0);
+  CHECK(DS3231_ModifyControl(ALARM1_INT_ENABLE | ALARM2_INT_ENABLE, ALARM1_INT_ENABLE | ALARM2_INT_ENABLE) == 0);
+  CHECK(DS3231_ServiceInterrupt(&fired) == 0 && fired == 0);
+  CHECK(DS3231_Sim_IntPin() == 1);
+
+  DS3231_Sim_Advance_us(4900000);
+  CHECK(DS3231_ReadAlarm1Flag() == 0);
+  DS3231_Sim_Advance_us(200000);
+  CHECK(DS3231_Sim_IntPin() == 0);
+  CHECK(DS3231_ReadAlarm1Flag() == 1);
+  CHECK(DS3231_ClearAlarm1Flag() == 0);
+  CHECK(DS3231_Sim_IntPin() == 1);
+
+  DS3231_Sim_Advance_us(5000000); // 12:01:00
+  CHECK(DS3231_ServiceInterrupt(&fired) == 0 && fired == DS3231_FLAG_A2F);
+  CHECK(DS3231_Sim_IntPin() == 1);
+}
+
+static void Test_Temperature(void)
+{
+  struct DS3231_BusCost cost;
+  int16_t t;
+
+  Setup();
+  CHECK(DS3231_StartTempConversion() == 0);
+  CHECK(DS3231_StartTempConversion() == 2);
+  CHECK(DS3231_PollTemp(&t) == 2);
+  DS3231_Sim_Advance_us(130000);
+  CHECK(DS3231_PollTemp(&t) == 0 && t == 2525);
+
+  // a poll keeps the alarm shadows: the same alarm is not written again, another one once
+  CHECK(DS3231_SetAlarm1(10, 20, 3, 255, 4) == 0);
+  CHECK(DS3231_PollTemp(&t) == 0);
+  DS3231_Bus_ResetCost();
+  CHECK(DS3231_SetAlarm1(10, 20, 3, 255, 4) == 0);
+  DS3231_Bus_GetCost(&cost);
+  CHECK(cost.starts == 0);
+  CHECK(DS3231_SetAlarm1(11, 20, 3, 255, 4) == 0);
+  DS3231_Bus_GetCost(&cost);
+  CHECK(cost.starts == 1 && cost.bytes == 6);
+  CHECK(DS3231_Sim_ReadRegister(ALARM1_SEC_ADDRESS) == 0x11);
+}
+
+#define LOG_MAX_EVENTS 64
+
+// decodes the EEPROM image like tools/DS3231_LogDecode.c, oldest event first. Returns the
+// number of events, -1 for a cut record
+static int Log_Decode(uint8_t* ids, uint32_t* epochs)
+{
+  const uint8_t* mem = DS3231_Sim_Eeprom() + DS3231_LOG_START;
+  uint16_t b, newest = 0, s;
+  uint32_t epoch, v;
+  uint8_t i, shift;
+  int n = 0, found = 0;
+
+  for(b = 0; b < DS3231_LOG_BLOCKS; b++)
+  {
+    s = mem[b*DS3231_LOG_BLOCK_SIZE] | (mem[b*DS3231_LOG_BLOCK_SIZE + 1] << 8);
+    if(s != 0xFFFF && (!found || (int16_t)(s - (mem[newest*DS3231_LOG_BLOCK_SIZE] | (mem[newest*DS3231_LOG_BLOCK_SIZE + 1] << 8))) > 0))
+      newest = b;
+    found |= (s != 0xFFFF);
+  }
+  for(b = newest + 1; found && b <= newest + DS3231_LOG_BLOCKS; b++)
+  {
+    const uint8_t* p = mem + (b % DS3231_LOG_BLOCKS)*DS3231_LOG_BLOCK_SIZE;
+    if(p[0] == 0xFF && p[1] == 0xFF)
+      continue;
+    epoch = p[2] | (p[3] << 8) | ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 24);
+    for(i = DS3231_LOG_HEADER_SIZE; i < DS3231_LOG_BLOCK_SIZE && p[i] != 0xFF; )
+    {
+      v = 0;
+      shift = 0;
+      while(i < DS3231_LOG_BLOCK_SIZE && shift < 35)
+      {
+        v |= (uint32_t)(p[i] & 0x7F) << shift;
+        shift += 7;
+        if(!(p[i++] & 0x80))
+          break;
+      }
+      if((p[i-1] & 0x80) || n == LOG_MAX_EVENTS)
+        return -1;
+      epoch += v >> DS3231_LOG_ID_BITS;
+      ids[n] = v & ((1 << DS3231_LOG_ID_BITS) - 1);
+      epochs[n++] = epoch;
+    }
+  }
+  return n;
+}
+
+// sequence number of the block of the EEPROM image
+static uint16_t Log_Seq(uint8_t b)
+{
+  const uint8_t* p = DS3231_Sim_Eeprom() + DS3231_LOG_START + b*DS3231_LOG_BLOCK_SIZE;
+  return p[0] | (p[1] << 8);
+}
+
+static void Test_Log(void)
+{
+  static const uint32_t t[] = {100, 103, 2143, 2143, 2150}; // 2040 s to the previous event, id 3: 83 FF 01
+  uint8_t ids[LOG_MAX_EVENTS];
+  uint32_t epochs[LOG_MAX_EVENTS];
+  const uint8_t* mem;
+  uint8_t i;
+
+  Setup();
+  mem = DS3231_Sim_Eeprom() + DS3231_LOG_START;
+  DS3231_Log_Clear();
+  CHECK(DS3231_Sim_EepromWrites() == 0); // the erased EEPROM is already 0xFF
+  DS3231_Log_Init();
+  CHECK(Log_Decode(ids, epochs) == 0);
+  for(i = 0; i < 3; i++)
+    CHECK(DS3231_Log_EventAt(i + 1, DS3231_EPOCH_2000 + t[i]) == 0);
+  CHECK(mem[DS3231_LOG_HEADER_SIZE + 2] == 0x83 && mem[DS3231_LOG_HEADER_SIZE + 3] == 0xFF && mem[DS3231_LOG_HEADER_SIZE + 4] == 0x01);
+
+  // after a reset the log goes on behind the record with the 0xFF byte
+  DS3231_Log_Init();
+  CHECK(DS3231_Log_EventAt(4, DS3231_EPOCH_2000 + t[3]) == 0);
+  DS3231_Log_Init();
+  CHECK(DS3231_Log_EventAt(5, DS3231_EPOCH_2000 + t[4]) == 0);
+  CHECK(Log_Decode(ids, epochs) == 5);
+  for(i = 0; i < 5; i++)
+    CHECK(ids[i] == i + 1 && epochs[i] == DS3231_EPOCH_2000 + t[i]);
+  CHECK(Log_Seq(0) == 0 && Log_Seq(1) == 0xFFFF);
+
+  // a full block: the next block starts with a keyframe and the next sequence number
+  for(i = 0; i < DS3231_LOG_BLOCK_SIZE - DS3231_LOG_HEADER_SIZE - 7; i++)
+    CHECK(DS3231_Log_EventAt(6, DS3231_EPOCH_2000 + t[4] + i + 1) == 0);
+  CHECK(Log_Seq(1) == 0xFFFF);
+  CHECK(DS3231_Log_EventAt(7, DS3231_EPOCH_2000 + 3000) == 0);
+  CHECK(Log_Seq(1) == 1);
+  CHECK(mem[DS3231_LOG_BLOCK_SIZE + 2] == (uint8_t)(DS3231_EPOCH_2000 + 3000));
+
+  // a delta that does not fit into the record and time going backwards start new blocks
+  CHECK(DS3231_Log_EventAt(8, DS3231_EPOCH_2000 + 3000 + (0xFFFFFFFFUL >> DS3231_LOG_ID_BITS) + 1) == 0);
+  CHECK(Log_Seq(2) == 2);
+  CHECK(DS3231_Log_EventAt(9, DS3231_EPOCH_2000 + 50) == 0);
+  CHECK(Log_Seq(3) == 3);
+  DS3231_Log_Init();
+  CHECK(DS3231_Log_EventAt(10, DS3231_EPOCH_2000 + 51) == 0);
+  CHECK(Log_Seq(4) == 0xFFFF);
+
+  CHECK(Log_Decode(ids, epochs) == 5 + DS3231_LOG_BLOCK_SIZE - DS3231_LOG_HEADER_SIZE - 7 + 4);
+  i = 5 + DS3231_LOG_BLOCK_SIZE - DS3231_LOG_HEADER_SIZE - 7;
+  CHECK(ids[i-1] == 6 && epochs[i-1] == DS3231_EPOCH_2000 + t[4] + i - 5);
+  CHECK(ids[i] == 7 && epochs[i] == DS3231_EPOCH_2000 + 3000);
+  CHECK(ids[i+1] == 8 && epochs[i+1] == DS3231_EPOCH_2000 + 3000 + (0xFFFFFFFFUL >> DS3231_LOG_ID_BITS) + 1);
+  CHECK(ids[i+2] == 9 && epochs[i+2] == DS3231_EPOCH_2000 + 50);
+  CHECK(ids[i+3] == 10 && epochs[i+3] == DS3231_EPOCH_2000 + 51);
+
+  CHECK(DS3231_Log_Event(3) == 0);
+  CHECK(DS3231_Log_EventAt(DS3231_LOG_MAX_ID + 1, DS3231_EPOCH_2000) == 2);
+}
+
+static void Test_Multi(void)
+{
+  struct DS3231_Dev direct, other, devs[2];
+  struct DS3231_DateTime out[2];
+  struct DS3231_BusCost cost;
+
+  // a DS3231 without mux is the only device
+  Setup();
+  CHECK(DS3231_Dev_Init(&direct, DS3231_NO_MUX, 0) == 0);
+  CHECK(DS3231_Dev_ReadDateTime(&direct, &out[0]) == 0);
+  CHECK(DS3231_Dev_Init(&other, DS3231_NO_MUX, 0) == 2);
+  CHECK(DS3231_Dev_Init(&other, DS3231_MUX_ADDRESS(0), 1) == 2);
+
+  // behind a mux, one device per channel
+  CHECK(DS3231_Dev_Init(&direct, DS3231_MUX_ADDRESS(0), 0) == 0);
+  CHECK(DS3231_Dev_Init(&devs[0], DS3231_MUX_ADDRESS(0), 1) == 0);
+  CHECK(DS3231_Dev_Init(&devs[1], DS3231_MUX_ADDRESS(0), 1) == 0);
+  CHECK(DS3231_ReadAllDateTimes(devs, 2, out) == 2);
+  CHECK(DS3231_Dev_Init(&other, DS3231_NO_MUX, 0) == 2);
+  devs[1].mux_address = DS3231_NO_MUX;
+  CHECK(DS3231_ReadAllDateTimes(devs, 2, out) == 2);
+
+  // two muxes, the channel of the previous mux is switched off before the next one is switched on
+  Setup();
+  DS3231_Sim_AddMux(0);
+  DS3231_Sim_AddMux(1);
+  CHECK(DS3231_Dev_Init(&devs[0], DS3231_MUX_ADDRESS(0), 1) == 0);
+  CHECK(DS3231_Dev_Init(&devs[1], DS3231_MUX_ADDRESS(1), 2) == 0);
+  CHECK(DS3231_ReadAllDateTimes(devs, 2, out) == 0);
+  CHECK(DS3231_Sim_MuxChannels(0) == 0x00 && DS3231_Sim_MuxChannels(1) == 0x04);
+  CHECK(devs[1].ctrl == DS3231_Sim_ReadRegister(CTRL_ADDRESS));
+  CHECK(devs[1].status == DS3231_Sim_ReadRegister(STATUS_ADDRESS));
+  CHECK(DS3231_Sim_Collisions() == 0);
+
+  // date and time and the control and status register, no alarm registers (4 starts, 15 bytes)
+  DS3231_Bus_ResetCost();
+  CHECK(DS3231_Dev_ReadDateTime(&devs[1], &out[1]) == 0);
+  DS3231_Bus_GetCost(&cost);
+  CHECK(cost.starts == 4 && cost.bytes == 15);
+
+  // a failed selection leaves the channel of mux 1 on, the next selection switches off all
+  // channels of every known mux first
+  DS3231_Sim_InjectFault(DS3231_SIM_NACK_ADDRESS, DS3231_BUS_RETRIES + 1);
+  CHECK(DS3231_Dev_Select(&devs[0]) != 0);
+  CHECK(DS3231_Sim_MuxChannels(1) == 0x04);
+  CHECK(DS3231_Dev_ReadDateTime(&devs[0], &out[0]) == 0);
+  CHECK(DS3231_Sim_MuxChannels(0) == 0x02 && DS3231_Sim_MuxChannels(1) == 0x00);
+  CHECK(DS3231_Sim_Collisions() == 0);
+}
+
+static uint8_t sched_runs[3];
+
+static void Sched_Callback(uint8_t id, uint16_t missed)
+{
+  (void)missed;
+  if(id < 3)
+    sched_runs[id]++;
+}
+
+static void Test_Sched(void)
+{
+  uint8_t id, i;
+
+  Setup();
+  memset(sched_runs, 0, sizeof(sched_runs));
+  CHECK(DS3231_Sched_Init() == 0);
+  CHECK(DS3231_Sched_AddIn(5, 10, Sched_Callback, &id) == 0 && id == 0);
+  CHECK(DS3231_Sched_AddIn(7, 0, Sched_Callback, &id) == 0 && id == 1);
+  for(i = 0; i < 30; i++)
+  {
+    DS3231_Sim_Advance_us(1000000);
+    if(DS3231_Sim_IntPin() == 0)
+      CHECK(DS3231_Sched_Service() == 0);
+  }
+  CHECK(sched_runs[0] == 3 && sched_runs[1] == 1);
+
+  // the scheduler leaves the alarm 2 flag to its other users
+  DS3231_Sim_WriteRegister(STATUS_ADDRESS, DS3231_Sim_ReadRegister(STATUS_ADDRESS) | DS3231_FLAG_A2F);
+  CHECK(DS3231_Sched_Service() == 0);
+  CHECK(DS3231_Sim_ReadRegister(STATUS_ADDRESS) & DS3231_FLAG_A2F);
+
+  // a deadline that has already passed runs on the next second, a null callback is refused
+  CHECK(DS3231_Sched_Init() == 0);
+  CHECK(DS3231_Sched_Add(0, 0, 0, &id) == 2);
+  CHECK(DS3231_Sched_Add(5, 0, Sched_Callback, &id) == 0 && id == 0);
+  DS3231_Sim_Advance_us(1000000);
+  CHECK(DS3231_Sim_IntPin() == 0);
+  CHECK(DS3231_Sched_Service() == 0 && sched_runs[0] == 4);
+
+  // the second of an already due deadline begins while alarm 1 is written (the time advances
+  // by the bus transfers): the alarm is programmed again, so the match is not lost
+  DS3231_Sim_Advance_us(999000 - DS3231_Sim_Subsecond_us());
+  CHECK(DS3231_Sched_Add(5, 0, Sched_Callback, &id) == 0);
+  DS3231_Sim_Advance_us(1000000);
+  CHECK(DS3231_Sim_IntPin() == 0);
+  CHECK(DS3231_Sched_Service() == 0 && sched_runs[0] == 5);
+}
+
+static void Test_Sleep(void)
+{
+  struct DS3231_WakeInfo info;
+  uint32_t before, after, offset;
+  uint8_t ret;
+
+  Setup();
+  CHECK(DS3231_ReadEpoch(&before) == 0);
+  CHECK(DS3231_SleepFor(10) == 0);
+  CHECK(DS3231_ReadEpoch(&after) == 0);
+  CHECK(after - before == 10);
+  DS3231_Sleep_GetWakeInfo(&info);
+  CHECK(info.late_seconds == 0 && info.early_wakeups == 0);
+
+  DS3231_Sim_WakeEarly(3000000); // another interrupt after 3 s, the MCU sleeps again
+  CHECK(DS3231_SleepFor(10) == 0);
+  DS3231_Sleep_GetWakeInfo(&info);
+  CHECK(info.late_seconds == 0 && info.early_wakeups == 1);
+  CHECK(DS3231_Sim_SleepLimitHits() == 0);
+
+  // the wake-up second begins while alarm 1 is written: the MCU must not sleep (alarm 1 would
+  // only match a month later), for every start in the last 5 ms of a second (2: the second
+  // began before the first read of DS3231_SleepFor)
+  for(offset = 0; offset < 5000; offset += 100)
+  {
+    DS3231_Sim_Advance_us(1000000 - offset - DS3231_Sim_Subsecond_us());
+    ret = DS3231_SleepFor(1);
+    CHECK(ret == 0 || ret == 2);
+    DS3231_Sleep_GetWakeInfo(&info);
+    CHECK(ret == 2 || info.late_seconds == 0);
+  }
+  CHECK(DS3231_Sim_SleepLimitHits() == 0);
+  CHECK(DS3231_Sim_IntPin() == 1);
+}
+
+int main(void)
+{
+  Test_DateTime();
+  Test_Faults();
+  Test_Alarms();
+  Test_Temperature();
+  Test_Log();
+  Test_Multi();
+  Test_Sched();
+  Test_Sleep();
+
+  printf("%u checks, %u failed\n", checks, failed);
+  return failed != 0;
+}
@@ -0,0 +1,39 @@
+#ifndef DS3231_HOST_GPIO_H
+#define DS3231_HOST_GPIO_H
+
+// Host stand-in for the Gpio driver. PC4 (SDA) and PC5 (SCL) are the lines of the simulated
+// bus, a pin set to GPIO_OUTPUT drives its line low (the lib only uses the pins open drain).
+// PD2 reads the INT/SQW pin of the simulated DS3231. Other pins read high.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIOB 1
+#define GPIOC 2
+#define GPIOD 3
+
+#define GPIO_PIN_0 0x01
+#define GPIO_PIN_1 0x02
+#define GPIO_PIN_2 0x04
+#define GPIO_PIN_3 0x08
+#define GPIO_PIN_4 0x10
+#define GPIO_PIN_5 0x20
+#define GPIO_PIN_6 0x40
+#define GPIO_PIN_7 0x80
+
+#define GPIO_INPUT 0
+#define GPIO_OUTPUT 1
+#define GPIO_NOPULLUP 0
+#define GPIO_PULLUP 1
+
+void GPIO_PinMode(uint8_t port, uint8_t pin, uint8_t mode, uint8_t pull);
+uint8_t GPIO_ReadPin(uint8_t port, uint8_t pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
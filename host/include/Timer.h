@@ -0,0 +1,18 @@
+#ifndef DS3231_HOST_TIMER_H
+#define DS3231_HOST_TIMER_H
+
+// Host stand-in for the Timer driver, a delay advances the time of the simulated DS3231.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void Timer0_Delay_us(uint16_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef DS3231_HOST_AVR_EEPROM_H
+#define DS3231_HOST_AVR_EEPROM_H
+
+// Host stand-in for <avr/eeprom.h>: a 1 KB EEPROM in RAM (erased to 0xFF by DS3231_Sim_Reset)
+// that counts its write cycles, see DS3231_Sim_EepromWrites.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t eeprom_read_byte(const uint8_t* addr);
+void eeprom_update_byte(uint8_t* addr, uint8_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
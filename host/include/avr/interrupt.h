@@ -0,0 +1,18 @@
+#ifndef DS3231_HOST_AVR_INTERRUPT_H
+#define DS3231_HOST_AVR_INTERRUPT_H
+
+// Host stand-in for <avr/interrupt.h>. Interrupts are never enabled on the host (SREG_I stays
+// 0), so the bus engine of DS3231_Bus.c is always driven by polling TWINT. An ISR becomes a
+// normal function that a test can call.
+
+#include "avr/io.h"
+
+#define sei() ((void)0)
+#define cli() ((void)0)
+#define ISR(vector) void vector(void)
+
+#define TWI_vect DS3231_Sim_TWI_vect
+#define INT0_vect DS3231_Sim_INT0_vect
+#define TIMER1_OVF_vect DS3231_Sim_TIMER1_OVF_vect
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef DS3231_HOST_AVR_IO_H
+#define DS3231_HOST_AVR_IO_H
+
+// Host stand-in for <avr/io.h>: the registers used by the DS3231 lib. The TWI registers are
+// backed by the simulated bus of DS3231_Sim.c, every access of TWCR lets the simulation carry
+// out the action requested by the last write. The other registers are plain variables.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+volatile uint8_t* DS3231_Sim_TWCR(void);
+uint16_t DS3231_Sim_Ticks(void); // free running microsecond counter, DS3231_TICKS of the host build
+
+extern volatile uint8_t DS3231_Sim_TWSR;
+extern volatile uint8_t DS3231_Sim_TWBR;
+extern volatile uint8_t DS3231_Sim_TWDR;
+extern volatile uint8_t DS3231_Sim_SREG;
+extern volatile uint8_t DS3231_Sim_EIMSK;
+extern volatile uint8_t DS3231_Sim_EICRA;
+extern volatile uint16_t DS3231_Sim_TCNT1;
+extern volatile uint8_t DS3231_Sim_TCCR1A;
+extern volatile uint8_t DS3231_Sim_TCCR1B;
+extern volatile uint8_t DS3231_Sim_TIMSK1;
+extern volatile uint8_t DS3231_Sim_TIFR1;
+
+#define TWCR (*DS3231_Sim_TWCR())
+#define TWSR DS3231_Sim_TWSR
+#define TWBR DS3231_Sim_TWBR
+#define TWDR DS3231_Sim_TWDR
+#define SREG DS3231_Sim_SREG
+#define EIMSK DS3231_Sim_EIMSK
+#define EICRA DS3231_Sim_EICRA
+#define TCNT1 DS3231_Sim_TCNT1
+#define TCCR1A DS3231_Sim_TCCR1A
+#define TCCR1B DS3231_Sim_TCCR1B
+#define TIMSK1 DS3231_Sim_TIMSK1
+#define TIFR1 DS3231_Sim_TIFR1
+
+// TWCR
+#define TWIE 0
+#define TWEN 2
+#define TWWC 3
+#define TWSTO 4
+#define TWSTA 5
+#define TWEA 6
+#define TWINT 7
+
+// TWSR
+#define TWPS0 0
+#define TWPS1 1
+
+#define SREG_I 7
+
+// EIMSK, EICRA
+#define INT0 0
+#define INT1 1
+#define ISC00 0
+#define ISC01 1
+
+// Timer1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define TOIE1 0
+#define TOV1 0
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
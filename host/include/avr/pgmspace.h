@@ -0,0 +1,12 @@
+#ifndef DS3231_HOST_AVR_PGMSPACE_H
+#define DS3231_HOST_AVR_PGMSPACE_H
+
+// Host stand-in for <avr/pgmspace.h>, flash and RAM are the same address space.
+
+#include <string.h>
+
+#define PROGMEM
+#define memcpy_P(dst, src, n) memcpy((dst), (src), (n))
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+#endif
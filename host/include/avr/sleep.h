@@ -0,0 +1,23 @@
+#ifndef DS3231_HOST_AVR_SLEEP_H
+#define DS3231_HOST_AVR_SLEEP_H
+
+// Host stand-in for <avr/sleep.h>. sleep_cpu lets the simulated DS3231 run until its INT/SQW
+// pin is low (or a limit is reached), see DS3231_Sim_Sleep.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void DS3231_Sim_Sleep(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define SLEEP_MODE_PWR_DOWN 2
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable() ((void)0)
+#define sleep_disable() ((void)0)
+#define sleep_cpu() DS3231_Sim_Sleep()
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef DS3231_HOST_UTIL_ATOMIC_H
+#define DS3231_HOST_UTIL_ATOMIC_H
+
+// Host stand-in for <util/atomic.h>. The host has no interrupts, the block runs once.
+
+#include <stdint.h>
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+#define ATOMIC_BLOCK(type) for(uint8_t ds3231_atomic_once = 1; ds3231_atomic_once; ds3231_atomic_once = 0)
+
+#endif
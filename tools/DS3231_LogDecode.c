@@ -0,0 +1,100 @@
+// Host side decoder for the event log of the DS3231 lib (see DS3231_Log.h).
+// Build: cc -o DS3231_LogDecode DS3231_LogDecode.c
+// Usage: DS3231_LogDecode dump.bin [block_size [id_bits]]   (raw dump of the log storage,
+//        from DS3231_LOG_START, defaults 32 and 4 as in DS3231_Log.h)
+//        DS3231_LogDecode < dump.bin
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MAX_SIZE 65536
+
+static uint8_t mem[MAX_SIZE];
+
+static uint16_t read_seq(const uint8_t* b)
+{
+  return b[0] | (b[1] << 8);
+}
+
+int main(int argc, char** argv)
+{
+  FILE* f = stdin;
+  size_t size, block_size = 32, blocks, b, newest = 0, i;
+  unsigned id_bits = 4;
+  uint32_t epoch, v;
+  unsigned shift, events = 0;
+  int found = 0;
+  char text[32];
+
+  if(argc > 1 && (f = fopen(argv[1], "rb")) == 0)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  if(argc > 2)
+    block_size = strtoul(argv[2], 0, 0);
+  if(argc > 3)
+    id_bits = strtoul(argv[3], 0, 0);
+  if(block_size <= 6 || id_bits < 1 || id_bits > 7)
+  {
+    fprintf(stderr, "invalid block size or id bits\n");
+    return 1;
+  }
+
+  size = fread(mem, 1, MAX_SIZE, f);
+  if(f != stdin)
+    fclose(f);
+  blocks = size / block_size;
+
+  // the newest block has the highest sequence number (with wrap around), 0xFFFF is erased
+  for(b = 0; b < blocks; b++)
+  {
+    uint16_t s = read_seq(mem + b*block_size);
+    if(s == 0xFFFF)
+      continue;
+    if(!found || (int16_t)(s - read_seq(mem + newest*block_size)) > 0)
+      newest = b;
+    found = 1;
+  }
+  if(!found)
+  {
+    printf("log is empty\n");
+    return 0;
+  }
+
+  // oldest to newest: the blocks after the newest one in ring order
+  for(b = newest + 1; b <= newest + blocks; b++)
+  {
+    const uint8_t* p = mem + (b % blocks)*block_size;
+    if(read_seq(p) == 0xFFFF)
+      continue;
+    epoch = p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t)p[5] << 24);
+    printf("block %u (seq %u)\n", (unsigned)(b % blocks), read_seq(p));
+
+    i = 6;
+    while(i < block_size && p[i] != 0xFF)
+    {
+      v = 0;
+      shift = 0;
+      while(i < block_size && shift < 35) // 0xFF is a valid continuation byte, only at the start of a record it ends the block
+      {
+        v |= (uint32_t)(p[i] & 0x7F) << shift;
+        shift += 7;
+        if(!(p[i++] & 0x80))
+          break;
+      }
+      if(p[i-1] & 0x80)
+      {
+        printf("      (cut record)\n");
+        break;
+      }
+      epoch += v >> id_bits;
+      time_t t = (time_t)epoch;
+      strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+      printf("%5u: %s  event %u\n", events++, text, (unsigned)(v & ((1u << id_bits) - 1)));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Host side decoder for the binary trace of the DS3231 lib (see DS3231_Trace.h).
+// Build: cc -o DS3231_TraceDecode DS3231_TraceDecode.c
+// Usage: DS3231_TraceDecode dump.bin   (raw DS3231_TraceEvent records, 4 bytes each)
+//        DS3231_TraceDecode < dump.bin
+
+#include <stdio.h>
+#include <stdint.h>
+
+static const char* reg_names[] = {
+  "SECONDS", "MINUTES", "HOURS", "DAY", "DATE", "MONTH", "YEAR",
+  "ALARM1_SEC", "ALARM1_MIN", "ALARM1_HOUR", "ALARM1_DYDT",
+  "ALARM2_MIN", "ALARM2_HOUR", "ALARM2_DYDT",
+  "CTRL", "STATUS", "AGING", "TEMP_MSB", "TEMP_LSB"
+};
+
+static const char* reg_name(uint8_t reg)
+{
+  return (reg < sizeof(reg_names)/sizeof(reg_names[0])) ? reg_names[reg] : "?";
+}
+
+// describes the result codes of the bus functions
+static const char* status_name(uint8_t status)
+{
+  switch(status)
+  {
+    case 0x00: return "ok";
+    case 0x01: return "timeout";
+    case 0x02: return "invalid/queue full";
+    case 0x20: return "address nack (write)";
+    case 0x30: return "data nack";
+    case 0x38: return "arbitration lost";
+    case 0x48: return "address nack (read)";
+    default: return "TWI status";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  FILE* f = stdin;
+  uint8_t ev[4];
+  uint8_t expected = 0;
+  int first = 1;
+
+  if(argc > 1 && (f = fopen(argv[1], "rb")) == 0)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  while(fread(ev, 1, 4, f) == 4)
+  {
+    if(!first && ev[3] != expected)
+      printf("      (%u events lost)\n", (uint8_t)(ev[3] - expected));
+    first = 0;
+    expected = ev[3] + 1;
+
+    printf("%3u: ", ev[3]);
+    switch(ev[0])
+    {
+      case 1: printf("init        CTRL = 0x%02X\n", ev[2]); break;
+      case 2: printf("read        %-12s 0x%02X (%s)\n", reg_name(ev[1]), ev[2], status_name(ev[2])); break;
+      case 3: printf("write       %-12s 0x%02X (%s)\n", reg_name(ev[1]), ev[2], status_name(ev[2])); break;
+      case 4: printf("abort       %u operations\n", ev[2]); break;
+      case 5: printf("bus init    TWBR = %u %s\n", ev[1], ev[2] ? "(speed not achievable)" : ""); break;
+      case 6: printf("soft drift  %d s\n", (int8_t)ev[2]); break;
+      case 7: printf("recover     %u SCL pulses %s\n", ev[1], ev[2] ? "(bus still stuck)" : ""); break;
+      case 8: printf("retry       %-12s 0x%02X (%s)\n", reg_name(ev[1]), ev[2], status_name(ev[2])); break;
+      default: printf("unknown event %u reg 0x%02X status 0x%02X\n", ev[0], ev[1], ev[2]); break;
+    }
+  }
+
+  if(f != stdin)
+    fclose(f);
+  return 0;
+}